@@ -0,0 +1,261 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <jank.hh>
+#include <sink.hh>
+#include <archive.hh>
+
+namespace config {
+
+	bool create = false;
+	bool list = false;
+	const char *device = "";
+	size_t block_rows = jank::archive::writer::default_block_rows;
+	const char *filename = nullptr;
+
+	int argc;
+	char **argv;
+
+	void usage() {
+
+		std::string prog = basename(argv[0]);
+
+		std::cout << std::endl << "usage: " << prog << " [options] archive [file...]" << std::endl << std::endl;
+
+		std::cout << "\t-h          show this help" << std::endl;
+		std::cout << "\t-c          create archive from READ output text (stdin when no files)" << std::endl;
+		std::cout << "\t-l          list reads in READ output format" << std::endl;
+		std::cout << "\t-D device   device name recorded for imported reads" << std::endl;
+		std::cout << "\t-b rows     rows per column block (default=" << block_rows << ")" << std::endl;
+		std::cout << "\t            without -c or -l a summary of the archive is printed" << std::endl;
+
+		std::cout << std::endl;
+	}
+
+	void init(int my_argc, char **my_argv) {
+
+		argc = my_argc;
+		argv = my_argv;
+	}
+
+	bool parse() {
+
+		int opt;
+
+		while((opt = getopt(argc, argv, "hclD:b:")) != -1) {
+
+			switch(opt) {
+
+				case 'c': create = not create; break;
+				case 'l': list   = not list  ; break;
+				case 'D': device = optarg; break;
+				case 'b': block_rows = std::max(1L, atol(optarg)); break;
+
+				case 'h':
+				default:
+						  return false;
+			}
+		}
+
+		if(optind >= argc)
+			return false;
+
+		filename = argv[optind++];
+
+		return true;
+	}
+}
+
+//
+// READ output is three "trackN (STATUS) data" lines per card, as printed
+// by print_track()
+//
+
+bool import(FILE *f, jank::archive::writer& w, const std::string& device, unsigned long& seq) {
+
+	char line[1024];
+
+	std::string tracks[3] = { jank::track::empty, jank::track::empty, jank::track::empty };
+
+	int seen = 0;
+
+	auto put = [&] {
+		jank::sink::record r = { ++seq, std::chrono::system_clock::time_point(), &device, jank::sink::op::read, true, 0, { &tracks[0], &tracks[1], &tracks[2] } };
+		for(auto& t : tracks)
+			if(t == jank::track::error)
+				r.ok = false;
+		seen = 0;
+		bool success = w.put(r);
+		for(auto& t : tracks)
+			t = jank::track::empty;
+		return success;
+	};
+
+	while(fgets(line, sizeof(line), f) != nullptr) {
+
+		unsigned int no;
+		char status[8];
+		int n = 0;
+
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if(sscanf(line, "track%u (%7[A-Z])%n", &no, status, &n) != 2 or no < 1 or no > 3)
+			continue;
+
+		if(no == 1 and seen != 0 and not put())
+			return false;
+
+		auto& t = tracks[no - 1];
+
+		if(strcmp(status, "OK") == 0)
+			t = line[n] == ' ' ? line + n + 1 : line + n;
+		else if(strcmp(status, "ERROR") == 0)
+			t = jank::track::error;
+		else
+			t = jank::track::empty;
+
+		seen |= 1 << (no - 1);
+
+		if(no == 3 and not put())
+			return false;
+	}
+
+	return seen == 0 or put();
+}
+
+int create() {
+
+	jank::archive::writer w;
+
+	std::string device(config::device);
+
+	unsigned long seq = 0;
+
+	int fd = open(config::filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd == -1) {
+		perror(config::filename);
+		return EXIT_FAILURE;
+	}
+
+	w.block_rows = config::block_rows;
+
+	if(not w.open(fd)) {
+		perror(config::filename);
+		return EXIT_FAILURE;
+	}
+
+	bool success = true;
+
+	if(optind == config::argc) {
+		success = import(stdin, w, device, seq);
+	} else for(int n = optind; success and n < config::argc; n++) {
+		FILE *f = fopen(config::argv[n], "r");
+		if(f == nullptr) {
+			perror(config::argv[n]);
+			return EXIT_FAILURE;
+		}
+		success = import(f, w, device, seq);
+		fclose(f);
+	}
+
+	if(not success or not w.close()) {
+		perror(config::filename);
+		return EXIT_FAILURE;
+	}
+
+	close(fd);
+
+	std::cout << "rows=" << seq << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+int list(const jank::archive::reader& r) {
+
+	const char *names[] = { "OK", "EMPTY", "ERROR" };
+
+	for(size_t b = 0; b < r.blocks(); b++) {
+
+		auto k = r.get(b);
+
+		for(size_t row = 0; row < k.rows; row++) {
+			for(int no = 0; no < 3; no++) {
+				std::cout << "track" << (no + 1) << " (" << names[std::min(k.status[no][row], (uint8_t)2)] << ')';
+				if(k.status[no][row] == (uint8_t)jank::archive::state::ok)
+					std::cout << ' ' << k.track(row, no);
+				std::cout << '\n';
+			}
+		}
+	}
+
+	std::cout << std::flush;
+
+	return EXIT_SUCCESS;
+}
+
+int summary(const jank::archive::reader& r) {
+
+	unsigned long counts[3][3] = { { 0 } };
+	unsigned long bytes = 0;
+	unsigned long failed = 0;
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	for(size_t b = 0; b < r.blocks(); b++) {
+
+		auto k = r.get(b);
+
+		for(size_t row = 0; row < k.rows; row++)
+			failed += k.ok[row] ? 0 : 1;
+
+		for(int no = 0; no < 3; no++) {
+			for(size_t row = 0; row < k.rows; row++)
+				counts[no][std::min(k.status[no][row], (uint8_t)2)]++;
+			bytes += k.offsets[no][k.rows];
+		}
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	std::cout << "rows="    << r.rows()   << std::endl;
+	std::cout << "blocks="  << r.blocks() << std::endl;
+	std::cout << "failed="  << failed     << std::endl;
+	std::cout << "bytes="   << bytes      << std::endl;
+
+	for(int no = 0; no < 3; no++)
+		std::cout << "track" << (no + 1) << "=" << counts[no][0] << " ok " << counts[no][1] << " empty " << counts[no][2] << " error" << std::endl;
+
+	std::cout << "scan_ms=" << std::chrono::duration<double, std::milli>(t1 - t0).count() << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+
+	jank::archive::reader r;
+
+	config::init(argc, argv);
+
+	if(not config::parse()) {
+		config::usage();
+		return EXIT_FAILURE;
+	}
+
+	if(config::create)
+		return create();
+
+	if(not r.open(config::filename)) {
+		perror(config::filename);
+		return EXIT_FAILURE;
+	}
+
+	return config::list ? list(r) : summary(r);
+}
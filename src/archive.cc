@@ -0,0 +1,386 @@
+#include <string>
+#include <chrono>
+
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <jank.hh>
+#include <archive.hh>
+
+namespace jank {
+
+	namespace archive {
+
+		state state_of(const std::string& t) {
+			return t.empty() or t == track::empty ? state::empty : t == track::error ? state::error : state::ok;
+		}
+
+		writer::writer() : block_rows(default_block_rows), fd(-1), offset(0) {
+		}
+
+		writer::~writer() {
+			close();
+		}
+
+		bool writer::open(int my_fd) {
+
+			if(fd != -1) {
+				errno = EALREADY;
+				return false;
+			}
+
+			fd = my_fd;
+			offset = 0;
+
+			index.clear();
+			dictionary.clear();
+			devices.clear();
+
+			return emit(magic, sizeof(magic));
+		}
+
+		bool writer::put(const sink::record& r) {
+
+			static const std::string none;
+
+			const std::string& name = r.device ? *r.device : none;
+
+			auto iter = dictionary.find(name);
+
+			if(iter == dictionary.end()) {
+				iter = dictionary.emplace(name, (uint16_t)devices.size()).first;
+				devices.push_back(&iter->first);
+			}
+
+			time.push_back(std::chrono::duration_cast<std::chrono::microseconds>(r.time.time_since_epoch()).count());
+			device.push_back(iter->second);
+			op.push_back((uint8_t)r.what);
+			ok.push_back(r.ok ? 1 : 0);
+			msr_errno.push_back((uint8_t)r.msr_errno);
+
+			for(int no = 0; no < 3; no++) {
+
+				const std::string& t = *r.tracks[no];
+
+				state s = state_of(t);
+
+				status[no].push_back((uint8_t)s);
+
+				if(offsets[no].empty())
+					offsets[no].push_back(0);
+
+				if(s == state::ok)
+					data[no].append(t);
+
+				offsets[no].push_back(data[no].length());
+			}
+
+			if(time.size() >= block_rows)
+				return flush();
+
+			return true;
+		}
+
+		bool writer::emit(const void *p, size_t sz) {
+
+			const char *q = (const char *)p;
+
+			size_t done = 0;
+
+			while(done < sz) {
+
+				ssize_t n = ::write(fd, q + done, sz - done);
+
+				if(n == -1) {
+					if(errno == EINTR)
+						continue;
+					return false;
+				}
+
+				done += n;
+			}
+
+			offset += sz;
+
+			return true;
+		}
+
+		bool writer::column(const void *p, size_t sz, uint64_t& at) {
+
+			const char zero[8] = { 0 };
+
+			at = offset;
+
+			return emit(p, sz) and emit(zero, (8 - sz % 8) % 8);
+		}
+
+		bool writer::flush() {
+
+			block_index b;
+
+			size_t n = time.size();
+
+			if(fd == -1) {
+				errno = EBADF;
+				return false;
+			}
+
+			if(n == 0)
+				return true;
+
+			memset(&b, 0, sizeof(b));
+
+			b.rows = n;
+
+			bool success =
+				column(time.data(), n * sizeof(int64_t), b.time) and
+				column(device.data(), n * sizeof(uint16_t), b.device) and
+				column(op.data(), n, b.op) and
+				column(ok.data(), n, b.ok) and
+				column(msr_errno.data(), n, b.msr_errno);
+
+			for(int no = 0; success and no < 3; no++)
+				success = column(status[no].data(), n, b.status[no]);
+
+			for(int no = 0; success and no < 3; no++)
+				success = column(offsets[no].data(), (n + 1) * sizeof(uint32_t), b.offsets[no]);
+
+			for(int no = 0; success and no < 3; no++)
+				success = column(data[no].data(), data[no].length(), b.data[no]);
+
+			if(not success)
+				return false;
+
+			index.push_back(b);
+
+			time.clear();
+			device.clear();
+			op.clear();
+			ok.clear();
+			msr_errno.clear();
+
+			for(int no = 0; no < 3; no++) {
+				status[no].clear();
+				offsets[no].clear();
+				data[no].clear();
+			}
+
+			return true;
+		}
+
+		bool writer::close() {
+
+			const char zero[8] = { 0 };
+
+			if(fd == -1)
+				return false;
+
+			if(not flush())
+				return false;
+
+			trailer t;
+
+			t.footer = offset;
+			memcpy(t.magic, index_magic, sizeof(t.magic));
+
+			footer f = { index.size(), devices.size() };
+
+			bool success = emit(&f, sizeof(f)) and emit(index.data(), index.size() * sizeof(block_index));
+
+			size_t dictionary_sz = 0;
+
+			for(auto name : devices) {
+				uint32_t len = name->length();
+				success = success and emit(&len, sizeof(len)) and emit(name->data(), len);
+				dictionary_sz += sizeof(len) + len;
+			}
+
+			success = success and emit(zero, (8 - dictionary_sz % 8) % 8) and emit(&t, sizeof(t));
+
+			fd = -1;
+
+			return success;
+		}
+
+		reader::reader() : base(nullptr), length(0), index(nullptr), nblocks(0), nrows(0) {
+		}
+
+		reader::~reader() {
+			close();
+		}
+
+		template <class T> const T *reader::at(uint64_t off, size_t count) const {
+			if(off % alignof(T) != 0 or off > length or count > (length - off) / sizeof(T))
+				return nullptr;
+			return (const T *)(base + off);
+		}
+
+		bool reader::open(const char *path) {
+
+			struct stat sb;
+
+			if(base != nullptr) {
+				errno = EALREADY;
+				return false;
+			}
+
+			int fd = ::open(path, O_RDONLY);
+			if(fd == -1)
+				return false;
+
+			if(fstat(fd, &sb) == -1) {
+				int e = errno;
+				::close(fd);
+				errno = e;
+				return false;
+			}
+
+			length = sb.st_size;
+
+			if(length < sizeof(magic) + sizeof(footer) + sizeof(trailer)) {
+				::close(fd);
+				errno = EPROTO;
+				return false;
+			}
+
+			void *p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+
+			::close(fd);
+
+			if(p == MAP_FAILED)
+				return false;
+
+			base = (const char *)p;
+
+			madvise(p, length, MADV_SEQUENTIAL);
+
+			const trailer *t = at<trailer>(length - sizeof(trailer), 1);
+			const footer *f = t ? at<footer>(t->footer, 1) : nullptr;
+
+			if(memcmp(base, magic, sizeof(magic)) != 0 or t == nullptr or memcmp(t->magic, index_magic, sizeof(index_magic)) != 0 or f == nullptr)
+				goto failure;
+
+			nblocks = f->blocks;
+
+			index = at<block_index>(t->footer + sizeof(footer), nblocks);
+			if(index == nullptr)
+				goto failure;
+
+			{
+				uint64_t off = t->footer + sizeof(footer) + nblocks * sizeof(block_index);
+
+				for(uint64_t d = 0; d < f->devices; d++) {
+
+					const uint32_t *len = at<uint32_t>(off, 1);
+
+					if(len == nullptr or at<char>(off + sizeof(uint32_t), *len) == nullptr)
+						goto failure;
+
+					devices.emplace_back(base + off + sizeof(uint32_t), *len);
+
+					off += sizeof(uint32_t) + *len;
+				}
+			}
+
+			nrows = 0;
+
+			for(size_t n = 0; n < nblocks; n++) {
+
+				const block_index& b = index[n];
+
+				if(not at<int64_t>(b.time, b.rows) or not at<uint16_t>(b.device, b.rows) or not at<uint8_t>(b.op, b.rows) or not at<uint8_t>(b.ok, b.rows) or not at<uint8_t>(b.msr_errno, b.rows))
+					goto failure;
+
+				for(int no = 0; no < 3; no++) {
+
+					const uint32_t *o = at<uint32_t>(b.offsets[no], b.rows + 1);
+
+					if(o == nullptr or not at<uint8_t>(b.status[no], b.rows) or not at<char>(b.data[no], o[b.rows]))
+						goto failure;
+
+					for(size_t r = 0; r < b.rows; r++)
+						if(o[r] > o[r + 1])
+							goto failure;
+				}
+
+				const uint16_t *dev = at<uint16_t>(b.device, b.rows);
+
+				for(size_t r = 0; r < b.rows; r++)
+					if(dev[r] >= devices.size())
+						goto failure;
+
+				nrows += b.rows;
+			}
+
+			return true;
+
+		failure:
+			close();
+			errno = EPROTO;
+			return false;
+		}
+
+		bool reader::close() {
+
+			if(base == nullptr)
+				return false;
+
+			munmap((void *)base, length);
+
+			base = nullptr;
+			length = 0;
+			index = nullptr;
+			nblocks = 0;
+			nrows = 0;
+
+			devices.clear();
+
+			return true;
+		}
+
+		size_t reader::rows() const {
+			return nrows;
+		}
+
+		size_t reader::blocks() const {
+			return nblocks;
+		}
+
+		std::string_view reader::device(uint16_t n) const {
+			return devices[n];
+		}
+
+		reader::block reader::get(size_t n) const {
+
+			const block_index& b = index[n];
+
+			block k;
+
+			k.rows = b.rows;
+			k.time = at<int64_t>(b.time, b.rows);
+			k.device = at<uint16_t>(b.device, b.rows);
+			k.op = at<uint8_t>(b.op, b.rows);
+			k.ok = at<uint8_t>(b.ok, b.rows);
+			k.msr_errno = at<uint8_t>(b.msr_errno, b.rows);
+
+			for(int no = 0; no < 3; no++) {
+				k.status[no] = at<uint8_t>(b.status[no], b.rows);
+				k.offsets[no] = at<uint32_t>(b.offsets[no], b.rows + 1);
+				k.data[no] = base + b.data[no];
+			}
+
+			return k;
+		}
+
+		std::string_view reader::block::track(size_t r, int no) const {
+			if(status[no][r] != (uint8_t)state::ok)
+				return std::string_view();
+			return std::string_view(data[no] + offsets[no][r], offsets[no][r + 1] - offsets[no][r]);
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <bit>
+
+#include <cstdint>
+
+#include <sink.hh>
+
+namespace jank {
+
+	namespace archive {
+
+		static_assert(std::endian::native == std::endian::little, "archive columns are mapped in place as little endian");
+
+		constexpr char magic[8] = { 'J', 'A', 'N', 'K', 'A', 'R', 'C', '1' };
+		constexpr char index_magic[8] = { 'J', 'A', 'N', 'K', 'I', 'D', 'X', '1' };
+
+		//
+		// file layout: magic, then blocks of 8-byte aligned columns, then the
+		// footer (block_index[blocks] and the device dictionary), then trailer
+		//
+
+		struct block_index {
+			uint64_t rows;
+			uint64_t time;
+			uint64_t device;
+			uint64_t op;
+			uint64_t ok;
+			uint64_t msr_errno;
+			uint64_t status[3];
+			uint64_t offsets[3];
+			uint64_t data[3];
+		};
+
+		struct footer {
+			uint64_t blocks;
+			uint64_t devices;
+		};
+
+		struct trailer {
+			uint64_t footer;
+			char magic[8];
+		};
+
+		enum class state : uint8_t { ok = 0, empty = 1, error = 2 };
+
+		class writer {
+
+			public:
+
+				constexpr static size_t default_block_rows = 4096;
+
+				size_t block_rows;
+
+				bool open(int);
+				bool put(const sink::record&);
+				bool flush();
+				bool close();
+
+				writer();
+				~writer();
+
+			private:
+
+				int fd;
+
+				uint64_t offset;
+
+				std::vector<block_index> index;
+
+				std::map<std::string, uint16_t> dictionary;
+				std::vector<const std::string *> devices;
+
+				std::vector<int64_t> time;
+				std::vector<uint16_t> device;
+				std::vector<uint8_t> op;
+				std::vector<uint8_t> ok;
+				std::vector<uint8_t> msr_errno;
+				std::vector<uint8_t> status[3];
+				std::vector<uint32_t> offsets[3];
+				std::string data[3];
+
+				bool emit(const void *, size_t);
+				bool column(const void *, size_t, uint64_t&);
+		};
+
+		class reader {
+
+			public:
+
+				struct block {
+
+					size_t rows;
+
+					const int64_t *time;
+					const uint16_t *device;
+					const uint8_t *op;
+					const uint8_t *ok;
+					const uint8_t *msr_errno;
+					const uint8_t *status[3];
+					const uint32_t *offsets[3];
+					const char *data[3];
+
+					std::string_view track(size_t, int) const;
+				};
+
+				bool open(const char *);
+				bool close();
+
+				size_t rows() const;
+				size_t blocks() const;
+
+				block get(size_t) const;
+
+				std::string_view device(uint16_t) const;
+
+				reader();
+				~reader();
+
+			private:
+
+				const char *base;
+				size_t length;
+
+				const block_index *index;
+				size_t nblocks;
+				size_t nrows;
+
+				std::vector<std::string_view> devices;
+
+				template <class T> const T *at(uint64_t, size_t) const;
+		};
+
+		state state_of(const std::string&);
+	}
+}
@@ -0,0 +1,1043 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+
+#include <cstring>
+#include <cstdio>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <jank.hh>
+#include <format.hh>
+#include <batch.hh>
+#include <model.hh>
+
+namespace jank {
+
+	//
+	// queues the pattern in place of any unfinished one and returns at
+	// once; the steps go out from the device's sync() and idle() while
+	// later commands run
+	//
+
+	void flash(const msr& dev, int n, int ms) {
+		dev.clear_signals();
+		for(int y = 0; y < n; y++) {
+			dev.signal(msr::led::on, ms);
+			dev.signal(msr::led::off, ms);
+		}
+	}
+
+	batch::duration_type batch::stats::host() const {
+		return total - device - sleep;
+	}
+
+	double batch::stats::cards_per_minute() const {
+		return total.count() > 0 ? cards * 60.0 / total.count() : 0;
+	}
+
+	double batch::stats::yield() const {
+		return verified + rejected > 0 ? (double)verified / (verified + rejected) : 0;
+	}
+
+	double batch::stats::percentile(double p) const {
+
+		if(latency.empty())
+			return 0;
+
+		std::vector<double> v(latency);
+
+		std::sort(v.begin(), v.end());
+
+		return v[std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5))];
+	}
+
+	void batch::stats::clear() {
+		records = cards = skipped = attempts = failures = duplicates = verified = rejected = switches = 0;
+		device = sleep = total = duration_type::zero();
+		latency.clear();
+	}
+
+	batch::batch(msr& my_dev) : dev(my_dev), policy(nullptr), verify(verify_mode::none), out(nullptr), index(nullptr), progress(nullptr), events(nullptr), interrupt_fd(-1), limit(0) {
+		st.clear();
+	}
+
+	void batch::pause(int ms) {
+		auto t0 = clock_type::now();
+		dev.idle(ms);
+		st.sleep += clock_type::now() - t0;
+	}
+
+	void batch::flash(int n, int ms) {
+		jank::flash(dev, n, ms);
+	}
+
+	void batch::begin() {
+		started = clock_type::now();
+	}
+
+	void batch::end(bool ok) {
+		st.records++;
+		if(ok)
+			st.cards++;
+		st.latency.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - started).count());
+	}
+
+	bool batch::write(int n, const std::string& t1, const std::string& t2, const std::string& t3) {
+
+		st.attempts++;
+
+		//
+		// neither may carry over from an earlier attempt or verify, or the
+		// retry policy would classify this one by it
+		//
+
+		errno = 0;
+		dev.msr_errno = 0;
+
+		if(timed([&] { return dev.write(t1, t2, t3); })) {
+			if(verify != verify_mode::none and not check(t1, t2, t3)) {
+				st.failures++;
+				publish(ring::kind::write, n, false, t1, t2, t3);
+				return false;
+			}
+			publish(ring::kind::write, n, true, t1, t2, t3);
+			if(policy != nullptr)
+				policy->success();
+			return true;
+		}
+
+		st.failures++;
+
+		if(errno != ECANCELED)
+			publish(ring::kind::write, n, false, t1, t2, t3);
+
+		return false;
+	}
+
+	//
+	// reads the card back, or reads raw bits and checks parity and LRC,
+	// and compares every track that was written; a mismatch fails with
+	// EBADMSG so the record goes around the retry loop again
+	//
+
+	bool batch::check(const std::string& t1, const std::string& t2, const std::string& t3) {
+
+		const std::string *wrote[3] = { &t1, &t2, &t3 };
+		const int bits[3] = { 7, 5, 5 };
+
+		std::string got[3];
+
+		std::cout << "swipe card again to verify or press <ENTER> to stop." << std::endl;
+
+		bool ok = verify == verify_mode::read ?
+			timed([&] { return dev.read(got[0], got[1], got[2]); }) :
+			timed([&] { return dev.rawrd(got[0], got[1], got[2]); });
+
+		if(not ok)
+			return false;
+
+		for(int no = 0; no < 3; no++) {
+
+			auto want = dedup::normalize(*wrote[no]);
+
+			if(want.empty())
+				continue;
+
+			std::string text;
+
+			bool valid = track::is_ok(got[no]);
+
+			if(valid and verify == verify_mode::rawrd) {
+				valid = decode_track(got[no], bits[no], text);
+				got[no] = text;
+			}
+
+			if(not valid or dedup::normalize(got[no]) != want) {
+				std::cout << "track" << (no + 1) << " verify failed: wrote " << want << " read " << (valid ? dedup::normalize(got[no]) : "(unreadable)") << std::endl;
+				st.rejected++;
+				dev.msr_errno = 0;
+				errno = EBADMSG;
+				return false;
+			}
+		}
+
+		st.verified++;
+
+		return true;
+	}
+
+	//
+	// with a policy set failures are handled without asking anyone; the
+	// retry callback is the attended fallback
+	//
+
+	bool batch::again(int n, bool& cancel) {
+
+		if(policy != nullptr) {
+
+			int e = errno;
+			int m = dev.msr_errno;
+			int wait;
+
+			auto what = policy->decide(n, m, e, wait);
+			auto name = retry_policy::name(policy->last());
+
+			dev.flush();
+
+			std::cout << "[" << n << "] " << name << " failure: " << (m != 0 ? msr::msr_strerror(m) : std::string(strerror(e)));
+
+			switch(what) {
+
+				case retry_policy::action::retry:
+					std::cout << ", retry " << policy->tries() << " of " << policy->rules[(size_t)policy->last()].limit << std::endl;
+					if(wait > 0)
+						pause(wait);
+					std::cout << "[" << n << "] retry, swipe card or press <ENTER> to stop." << std::endl;
+					return true;
+
+				case retry_policy::action::skip:
+					std::cout << ", skipping" << std::endl;
+					return false;
+
+				case retry_policy::action::stop:
+					std::cout << ", stopping" << std::endl;
+					cancel = true;
+					return false;
+			}
+		}
+
+		if(retry)
+			return retry(n, cancel, dev);
+
+		cancel = (errno == ECANCELED);
+
+		return false;
+	}
+
+	void batch::emit(sink::op what, int n, bool ok, const std::string& t1, const std::string& t2, const std::string& t3) {
+
+		sink::record r = { (unsigned long)n, std::chrono::system_clock::now(), &dev.device, what, ok, dev.msr_errno, { &t1, &t2, &t3 } };
+
+		out->put(r);
+	}
+
+	void batch::publish(ring::kind what, int n, bool ok, const std::string& t1, const std::string& t2, const std::string& t3) {
+		if(events != nullptr)
+			events->publish(what, n, ok, dev.msr_errno, ok ? 0 : errno, t1, t2, t3);
+	}
+
+	//
+	// only a whole record written before counts; a record sharing a track
+	// with another is still written
+	//
+
+	bool batch::encoded(const std::string& t1, const std::string& t2, const std::string& t3) {
+
+		uint32_t first = 0;
+
+		if(index == nullptr or not (index->lookup(t1, t2, t3, &first) & dedup::encoded))
+			return false;
+
+		std::cout << " : already encoded (record " << first << ")" << std::endl;
+
+		st.records++;
+		st.duplicates++;
+
+		return true;
+	}
+
+	//
+	// records a whole record as encoded once every pass of it succeeded
+	//
+
+	void batch::remember(int n, const std::string& t1, const std::string& t2, const std::string& t3) {
+		if(index != nullptr)
+			index->mark(t1, t2, t3, dedup::encoded, n);
+	}
+
+	void batch::seen(int n, const std::string& t1, const std::string& t2, const std::string& t3) {
+
+		uint32_t first = 0;
+
+		if(index == nullptr)
+			return;
+
+		uint32_t flags = index->lookup(t1, t2, t3, &first);
+
+		index->mark(t1, t2, t3, dedup::seen, n);
+
+		if(flags & dedup::encoded) {
+			std::cout << "[" << n << "] already encoded (record " << first << ")" << std::endl;
+			st.duplicates++;
+		} else if(flags & dedup::seen) {
+			std::cout << "[" << n << "] duplicate of read " << first << std::endl;
+			st.duplicates++;
+		} else if(flags & dedup::shared) {
+			std::cout << "[" << n << "] shares a track with record " << first << std::endl;
+		}
+	}
+
+	//
+	// picks up after the last finished record in the journal; returns the
+	// input offset to continue from
+	//
+
+	uint64_t batch::resume(int fd, workflow w, int& n) {
+
+		if(progress == nullptr)
+			return 0;
+
+		if(not progress->attach(fd, (uint32_t)w)) {
+			perror("JOURNAL");
+			return 0;
+		}
+
+		//
+		// a card that may or may not have been written is never written
+		// again; it is closed off as failed for the operator to check
+		//
+
+		if(progress->pending() > 0) {
+			int pending = progress->pending();
+			std::cout << "[" << pending << "] was being encoded when the last run stopped, skipping it; verify that card" << std::endl;
+			if(not progress->mark(journal::failed, pending, progress->pending_offset()) or not progress->commit()) {
+				perror("JOURNAL");
+				return 0;
+			}
+			st.records++;
+			st.skipped++;
+		}
+
+		n = progress->next() - 1;
+
+		if(n > 0) {
+			std::cout << "[" << n << "] resuming after record " << n;
+			if(progress->skipped() > 0)
+				std::cout << " (" << progress->skipped() << " failed)";
+			std::cout << std::endl;
+		}
+
+		return progress->offset();
+	}
+
+	void batch::skip(int from, int to) {
+
+		if(from > to)
+			return;
+
+		if(from == to)
+			std::cout << "[" << from << "] skipping" << std::endl;
+		else
+			std::cout << "[" << from << "-" << to << "] skipping" << std::endl;
+
+		st.records += to - from + 1;
+		st.skipped += to - from + 1;
+	}
+
+	bool batch::checkpoint(journal::kind what, int n, uint64_t offset) {
+		if(progress != nullptr and not progress->mark(what, n, offset)) {
+			perror("JOURNAL");
+			return false;
+		}
+		return true;
+	}
+
+	//
+	// seekable input jumps to the journal offset, a stream is read past the
+	// records finished earlier; then whatever is left before first_n is
+	// skipped
+	//
+
+	void batch::forward(line_reader& in, workflow w, int& n, int first_n) {
+
+		uint64_t offset = resume(in.fd, w, n);
+
+		if(n > 0 and not (in.seekable() and in.seek(offset)))
+			n = in.skip(n);
+
+		if(first_n > n + 1) {
+			int from = n + 1;
+			n += in.skip(first_n - from);
+			skip(from, n);
+		}
+	}
+
+	bool batch::t12(int fd, int first_n) {
+
+		auto t0 = clock_type::now();
+
+		int n = 0;
+		bool cancel = false;
+
+		line_reader in(fd, interrupt_fd);
+		std::string_view line;
+
+		std::cout << "/batch-write-track12/" << std::endl;
+
+		forward(in, workflow::t12, n, first_n);
+
+		while(not cancel and in.next(line)) {
+
+			auto pos = line.find('\t');
+			std::string t1(line.substr(0, pos));
+			std::string t2(pos == std::string_view::npos ? std::string_view() : line.substr(pos + 1));
+			std::cout << "[" << ++n << "] track1 = " << t1 << " track2 = " << t2;
+			if(encoded(t1, t2, "")) {
+				checkpoint(journal::done, n, in.offset);
+			} else {
+				bool ok;
+
+				begin();
+
+				std::cout << std::endl;
+				std::cout << "[" << n << "] TRACK1 swipe card or press <ENTER> to stop." << std::endl;
+
+				if(not checkpoint(journal::begin, n, in.offset)) {
+					cancel = true;
+					continue;
+				}
+
+				while(not (ok = write(n, t1, t2, "")) and again(n, cancel));
+
+				if(ok)
+					remember(n, t1, t2, "");
+
+				//
+				// a cancel resets the device before the card is written, so
+				// the record is left to be written next run
+				//
+
+				if(cancel)
+					checkpoint(journal::abandoned, n, in.offset);
+				else
+					checkpoint(ok ? journal::done : journal::failed, n, in.offset);
+
+				pause(500);
+
+				end(ok);
+			}
+		}
+
+		cancel = cancel or errno == ECANCELED;
+
+		if(progress != nullptr)
+			progress->commit();
+
+		st.total += clock_type::now() - t0;
+
+		return not cancel;
+	}
+
+	bool batch::t1t2(int fd, int first_n) {
+
+		auto t0 = clock_type::now();
+
+		int n = 0;
+		bool cancel = false;
+
+		line_reader in(fd, interrupt_fd);
+		std::string_view line;
+
+		std::cout << "/batch-write-track12/" << std::endl;
+
+		forward(in, workflow::t1t2, n, first_n);
+
+		while(not cancel and in.next(line)) {
+
+			auto pos = line.find('\t');
+			std::string t1(line.substr(0, pos));
+			std::string t2(pos == std::string_view::npos ? std::string_view() : line.substr(pos + 1));
+			std::cout << std::endl;
+			std::cout << "[" << ++n << "] track1 = " << t1 << " track2 = " << t2;
+			if(encoded(t1, t2, "")) {
+				checkpoint(journal::done, n, in.offset);
+			} else {
+				bool ok1;
+				bool ok2 = false;
+
+				begin();
+
+				std::cout << std::endl;
+				std::cout << "[" << n << "] swipe card or press <ENTER> to stop." << std::endl;
+
+				if(not checkpoint(journal::begin, n, in.offset)) {
+					cancel = true;
+					continue;
+				}
+
+				std::cout << "[" << n << "] swipe for track1 = " << t1 << std::endl;
+				while(not (ok1 = write(n, t1, "", "")) and again(n, cancel));
+
+				pause(500);
+
+				std::cout << std::endl;
+
+				if(not cancel) {
+					std::cout << "[" << n << "] swipe for track2 = " << t2 << std::endl;
+					while(not (ok2 = write(n, "", t2, "")) and again(n, cancel));
+				}
+
+				if(ok1 and ok2)
+					remember(n, t1, t2, "");
+
+				//
+				// once track1 is on the card a cancel leaves it half written,
+				// which counts as failed
+				//
+
+				if(cancel and not ok1)
+					checkpoint(journal::abandoned, n, in.offset);
+				else
+					checkpoint(ok1 and ok2 ? journal::done : journal::failed, n, in.offset);
+
+				pause(500);
+
+				end(ok1 and ok2);
+			}
+		}
+
+		cancel = cancel or errno == ECANCELED;
+
+		if(progress != nullptr)
+			progress->commit();
+
+		st.total += clock_type::now() - t0;
+
+		return not cancel;
+	}
+
+	//
+	// reads the whole job, plans it into runs and writes run by run; with
+	// split each track of a multi-track run is written across the whole
+	// run before the next, so the stack of cards goes through once per
+	// track instead of each card twice in a row
+	//
+
+	bool batch::job(int fd, bool split, bool hico) {
+
+		auto t0 = clock_type::now();
+
+		bool cancel = false;
+
+		line_reader in(fd, interrupt_fd);
+		std::string_view line;
+
+		plan work;
+
+		st.clear();
+
+		std::cout << "/batch-job/" << std::endl;
+
+		errno = 0;
+
+		while(in.next(line))
+			work.add(line, hico ? 'x' : 'y');
+
+		if(errno == ECANCELED)
+			return false;
+
+		work.build();
+
+		std::cout << "/plan/ records=" << work.records.size() << " runs=" << work.runs.size();
+		std::cout << " coercivity-switches=" << work.switches() << " (" << work.unplanned_switches() << " in file order)" << std::endl;
+
+		//
+		// a model built for one coercivity cannot be told to change it
+		//
+
+		const model::profile *profile = model::lookup(dev.model());
+
+		bool settable = profile == nullptr or profile->coercivity;
+
+		if(not settable and work.switches() > 0) {
+			std::cout << "/plan/ this model has a fixed coercivity, split the job into hico and loco files" << std::endl;
+			return false;
+		}
+
+		enum class outcome : char { pending, ok, failed, duplicate };
+
+		std::vector<outcome> results(work.records.size(), outcome::pending);
+
+		char current = 0;
+
+		for(auto& run : work.runs) {
+
+			if(cancel)
+				break;
+
+			if(run.coercivity != current) {
+
+				bool ok = not settable or timed([&] { return run.coercivity == 'x' ? dev.set_hico() : dev.set_loco(); });
+
+				if(current != 0)
+					st.switches++;
+
+				current = run.coercivity;
+
+				std::cout << std::endl << "/stock/ load " << (current == 'x' ? "HICO" : "LOCO") << " cards" << (ok ? "" : " (mode change failed)") << std::endl;
+			}
+
+			std::vector<uint8_t> passes;
+
+			for(uint8_t t : { plan::track1, plan::track2, plan::track3 })
+				if(split and (run.tracks & t))
+					passes.push_back(t);
+
+			if(passes.size() < 2)
+				passes.assign(1, run.tracks);
+
+			for(size_t pass = 0; pass < passes.size() and not cancel; pass++) {
+
+				if(passes.size() > 1) {
+					std::cout << std::endl << "/pass/ " << pass + 1 << " of " << passes.size() << ":";
+					for(int t = 0; t < 3; t++)
+						if(passes[pass] & (1 << t))
+							std::cout << " track" << t + 1;
+					std::cout << std::endl;
+				}
+
+				for(size_t k = run.first; k < run.first + run.count and not cancel; k++) {
+
+					auto& r = work.records[k];
+					auto& result = results[r.index];
+
+					int n = r.line;
+
+					if(result == outcome::failed or result == outcome::duplicate)
+						continue;
+
+					std::cout << "[" << n << "]";
+
+					for(int t = 0; t < 3; t++)
+						if(passes[pass] & (1 << t))
+							std::cout << " track" << t + 1 << " = " << r.track[t];
+
+					if(pass == 0 and encoded(r.track[0], r.track[1], r.track[2])) {
+						result = outcome::duplicate;
+						continue;
+					}
+
+					std::cout << std::endl << "[" << n << "] swipe card or press <ENTER> to stop." << std::endl;
+
+					auto track = [&](int t) -> const std::string& {
+						static const std::string none;
+						return passes[pass] & (1 << t) ? r.track[t] : none;
+					};
+
+					bool ok;
+					bool finished = false;
+
+					begin();
+
+					while(not (ok = write(n, track(0), track(1), track(2))) and again(n, cancel));
+
+					if(not cancel) {
+						result = ok ? (pass + 1 == passes.size() ? outcome::ok : outcome::pending) : outcome::failed;
+						if(result == outcome::ok)
+							remember(n, r.track[0], r.track[1], r.track[2]);
+						finished = pass + 1 == passes.size() or not ok;
+					}
+
+					pause(500);
+
+					if(finished)
+						end(ok);
+				}
+			}
+		}
+
+		cancel = cancel or errno == ECANCELED;
+
+		if(settable and current != 0 and current != (hico ? 'x' : 'y'))
+			timed([&] { return hico ? dev.set_hico() : dev.set_loco(); });
+
+		//
+		// results in the order of the job file
+		//
+
+		std::cout << std::endl << "/results/" << std::endl;
+
+		std::vector<uint32_t> lines(work.records.size());
+
+		for(auto& r : work.records)
+			lines[r.index] = r.line;
+
+		for(size_t n = 0; n < results.size(); n++) {
+			const char *what = results[n] == outcome::ok ? "OK" : results[n] == outcome::failed ? "FAILED" : results[n] == outcome::duplicate ? "DUPLICATE" : "NOT WRITTEN";
+			std::cout << "[" << lines[n] << "] " << what << std::endl;
+		}
+
+		st.total += clock_type::now() - t0;
+
+		return not cancel;
+	}
+
+	bool batch::t2(int fd, int first_n) {
+
+		auto t0 = clock_type::now();
+
+		int n = 0;
+		bool cancel = false;
+
+		struct stat sb;
+		void *p = MAP_FAILED;
+
+		std::cout << "/batch-write-track2/" << std::endl;
+
+		uint64_t offset = resume(fd, workflow::t2, n);
+
+		//
+		// regular files are scanned in place; streams are scanned a line
+		// at a time as the producer writes them, passing over the records
+		// a previous run finished
+		//
+
+		int done = n;
+		int seen = 0;
+		int skip_from = 0;
+
+		auto record = [&](std::string_view match, uint64_t after) {
+
+			if(++seen <= done)
+				return;
+
+			n = seen;
+
+			if(n < first_n) {
+				if(skip_from == 0)
+					skip_from = n;
+				return;
+			}
+
+			if(skip_from != 0) {
+				skip(skip_from, n - 1);
+				skip_from = 0;
+			}
+
+			std::string track2(match);
+
+			std::cout << "[" << n << "] track2 = " << track2;
+			if(encoded("", track2, "")) {
+				checkpoint(journal::done, n, after);
+			} else {
+				bool ok;
+
+				begin();
+
+				std::cout << std::endl;
+				std::cout << "[" << n << "] swipe card or press <ENTER> to stop." << std::endl;
+
+				if(not checkpoint(journal::begin, n, after)) {
+					cancel = true;
+					return;
+				}
+
+				while(not (ok = write(n, "", track2, "")) and again(n, cancel));
+
+				if(ok)
+					remember(n, "", track2, "");
+
+				if(cancel)
+					checkpoint(journal::abandoned, n, after);
+				else
+					checkpoint(ok ? journal::done : journal::failed, n, after);
+
+				pause(500);
+
+				end(ok);
+			}
+		};
+
+		size_t length;
+
+		if(fstat(fd, &sb) == 0 and S_ISREG(sb.st_mode) and sb.st_size > 0)
+			p = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if(p != MAP_FAILED) {
+
+			madvise(p, sb.st_size, MADV_SEQUENTIAL);
+
+			std::string_view text((const char *)p, sb.st_size);
+
+			seen = done;
+
+			for(size_t pos = offset; not cancel and (pos = find_track2(text, pos, length)) != std::string_view::npos; pos += length)
+				record(text.substr(pos, length), pos + length);
+
+			munmap(p, sb.st_size);
+
+		} else {
+
+			line_reader in(fd, interrupt_fd);
+			std::string_view line;
+
+			while(not cancel and in.next(line))
+				for(size_t pos = 0; not cancel and (pos = find_track2(line, pos, length)) != std::string_view::npos; pos += length)
+					record(line.substr(pos, length), in.offset);
+
+			cancel = cancel or errno == ECANCELED;
+		}
+
+		if(skip_from != 0)
+			skip(skip_from, n);
+
+		if(progress != nullptr)
+			progress->commit();
+
+		st.total += clock_type::now() - t0;
+
+		return not cancel;
+	}
+
+	bool batch::read() {
+
+		auto t0 = clock_type::now();
+
+		int n = 0;
+
+		std::string track1;
+		std::string track2;
+		std::string track3;
+
+		std::cout << "/batch-read/" << std::endl;
+
+		while(limit == 0 or n < limit) {
+
+			begin();
+
+			std::cout << '[' << (++n) << "] swipe card or press <ENTER> to stop." << std::endl;
+
+			st.attempts++;
+
+			bool ok = timed([&] { return dev.read(track1, track2, track3); });
+
+			if(!ok) {
+
+				st.failures++;
+
+				std::cerr << "msr::read  :: " << msr::msr_strerror(dev.msr_errno) << std::endl;
+				std::cerr << "sys. error :: " << strerror(errno) << std::endl;
+
+				if(errno == ECANCELED)
+					break;
+			}
+
+			if(ok)
+				seen(n, track1, track2, track3);
+
+			publish(ring::kind::read, n, ok, track1, track2, track3);
+
+			if(out != nullptr) {
+				emit(sink::op::read, n, ok, track1, track2, track3);
+			} else {
+				print_track(1, track1);
+				print_track(2, track2);
+				print_track(3, track3);
+			}
+
+			pause(500);
+
+			end(ok);
+		}
+
+		if(out != nullptr)
+			out->flush();
+
+		st.total += clock_type::now() - t0;
+
+		return true;
+	}
+
+	bool batch::rawrd(int t1, int t2, int t3) {
+
+		auto t0 = clock_type::now();
+
+		int n = 0;
+
+		std::string track1;
+		std::string track2;
+		std::string track3;
+
+		std::cout << "/batch-rawrd-" << t1 << t2 << t3 << "/" << std::endl;
+
+		while(limit == 0 or n < limit) {
+
+			begin();
+
+			std::cout << '[' << (++n) << "] swipe card or press <ENTER> to stop." << std::endl;
+
+			st.attempts++;
+
+			track1.clear();
+			track2.clear();
+			track3.clear();
+
+			bool ok = timed([&] { return dev.rawrd(track1, track2, track3); });
+
+			if(!ok) {
+
+				st.failures++;
+
+				std::cerr << "msr::rawrd :: " << msr::msr_strerror(dev.msr_errno) << std::endl;
+				std::cerr << "sys. error :: " << strerror(errno) << std::endl;
+
+				if(errno == ECANCELED)
+					break;
+			}
+
+			publish(ring::kind::rawrd, n, ok, track1, track2, track3);
+
+			if(out != nullptr) {
+				emit(sink::op::rawrd, n, ok, track1, track2, track3);
+			} else {
+				if(not track1.empty()) print_nbit(1, track1, t1);
+				if(not track2.empty()) print_nbit(2, track2, t2);
+				if(not track3.empty()) print_nbit(3, track3, t3);
+			}
+
+			pause(500);
+
+			end(ok);
+		}
+
+		if(out != nullptr)
+			out->flush();
+
+		st.total += clock_type::now() - t0;
+
+		return true;
+	}
+
+	bool batch::erase(bool t1, bool t2, bool t3) {
+
+		auto t0 = clock_type::now();
+
+		int n = 0;
+
+		std::cout << "/batch-erase-";
+		if(t1) std::cout << '1';
+		if(t2) std::cout << '2';
+		if(t3) std::cout << '3';
+		std::cout << '/' << std::endl;
+
+		dev.flush();
+
+		for(;;) {
+
+			begin();
+
+			std::cout << "[" << ++n << "] swipe card or press <ENTER> to stop." << std::endl;
+
+			flash(3, 50);
+
+			st.attempts++;
+
+			if(not timed([&] { return dev.erase(t1, t2, t3); })) {
+
+				int e = errno;
+
+				st.failures++;
+
+				if(e != ECANCELED) {
+					publish(ring::kind::erase, n, false);
+					end(false);
+				}
+
+				errno = e;
+
+				perror("ERASE");
+
+				break;
+			}
+
+			publish(ring::kind::erase, n, true);
+
+			end(true);
+
+			if(limit != 0 and n >= limit)
+				break;
+		}
+
+		st.total += clock_type::now() - t0;
+
+		return true;
+	}
+
+	bool batch::copy() {
+
+		auto t0 = clock_type::now();
+
+		bool done = false;
+
+		std::string track1;
+		std::string track2;
+		std::string track3;
+
+		std::cout << "/copy/" << std::endl;
+
+		while(not done) {
+
+			begin();
+
+			std::cout << "swipe read card or press <ENTER> to cancel." << std::endl;
+
+			st.attempts++;
+
+			if(timed([&] { return dev.read(track1, track2, track3); })) {
+
+				print_track(1, track1);
+				print_track(2, track2);
+				print_track(3, track3);
+
+				seen(st.records + 1, track1, track2, track3);
+
+				if(not track1.empty() and track1.front() == '%' and track1.back() == '?')
+					track1 = track1.substr(1, std::string::npos);
+
+				pause(500);
+
+				while(not done) {
+
+					std::cout << "swipe writ/ card or press <ENTER> to cancel." << std::endl;
+
+					if(write(st.records + 1, track1, track2, track3)) {
+
+						done = true;
+
+					} else {
+
+						std::cerr << "msr::write :: " << msr::msr_strerror(dev.msr_errno) << std::endl;
+						std::cerr << "sys. error :: " << strerror(errno) << std::endl;
+
+						if(errno == ECANCELED or errno == EINVAL)
+							break;
+					}
+
+					pause(500);
+				}
+
+				if(done)
+					end(true);
+
+			} else {
+
+				st.failures++;
+
+				std::cerr << "msr::read  :: " << msr::msr_strerror(dev.msr_errno) << std::endl;
+				std::cerr << "sys. error :: " << strerror(errno) << std::endl;
+
+				if(errno == ECANCELED)
+					break;
+			}
+
+			pause(500);
+		}
+
+		st.total += clock_type::now() - t0;
+
+		return done;
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+
+#include <jank.hh>
+#include <sink.hh>
+#include <dedup.hh>
+#include <journal.hh>
+#include <stream.hh>
+#include <retry.hh>
+#include <plan.hh>
+#include <ring.hh>
+
+namespace jank {
+
+	void flash(const msr&, int, int);
+
+	class batch {
+
+		public:
+
+			using clock_type = std::chrono::steady_clock;
+			using duration_type = std::chrono::duration<double>;
+
+			using retry_type = std::function<bool(int, bool&, msr&)>;
+
+			enum class workflow : uint32_t { t12 = 1, t1t2 = 2, t2 = 3 };
+
+			enum class verify_mode { none, read, rawrd };
+
+			struct stats {
+
+				unsigned long records;
+				unsigned long cards;
+				unsigned long skipped;
+				unsigned long attempts;
+				unsigned long failures;
+				unsigned long duplicates;
+				unsigned long verified;
+				unsigned long rejected;
+				unsigned long switches;
+
+				duration_type device;
+				duration_type sleep;
+				duration_type total;
+
+				std::vector<double> latency;
+
+				duration_type host() const;
+				double cards_per_minute() const;
+				double yield() const;
+				double percentile(double) const;
+
+				void clear();
+			};
+
+			msr& dev;
+
+			retry_type retry;
+
+			retry_policy *policy;
+
+			verify_mode verify;
+
+			sink *out;
+
+			dedup *index;
+
+			journal *progress;
+
+			ring *events;
+
+			int interrupt_fd;
+
+			long limit;
+
+			stats st;
+
+			bool t12(int, int);
+			bool t1t2(int, int);
+			bool t2(int, int);
+			bool job(int, bool, bool);
+
+			bool read();
+			bool rawrd(int, int, int);
+			bool erase(bool, bool, bool);
+			bool copy();
+
+			void pause(int);
+			void flash(int, int);
+
+			batch(msr&);
+
+		private:
+
+			clock_type::time_point started;
+
+			bool write(int, const std::string&, const std::string&, const std::string&);
+			bool check(const std::string&, const std::string&, const std::string&);
+			bool again(int, bool&);
+
+			void emit(sink::op, int, bool, const std::string&, const std::string&, const std::string&);
+			void publish(ring::kind, int, bool, const std::string& = "", const std::string& = "", const std::string& = "");
+
+			bool encoded(const std::string&, const std::string&, const std::string&);
+			void remember(int, const std::string&, const std::string&, const std::string&);
+			void seen(int, const std::string&, const std::string&, const std::string&);
+
+			uint64_t resume(int, workflow, int&);
+			void forward(line_reader&, workflow, int&, int);
+			void skip(int, int);
+			bool checkpoint(journal::kind, int, uint64_t);
+
+			void begin();
+			void end(bool);
+
+			template <class F> auto timed(F f) {
+				auto t0 = clock_type::now();
+				auto r = f();
+				st.device += clock_type::now() - t0;
+				return r;
+			}
+	};
+}
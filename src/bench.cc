@@ -0,0 +1,414 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <new>
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <jank.hh>
+#include <format.hh>
+#include <transport.hh>
+
+//
+// every global allocation is counted so each benchmark can report
+// allocations per operation alongside its time
+//
+
+namespace counter {
+	unsigned long allocs = 0;
+}
+
+void *operator new(size_t sz) {
+	counter::allocs++;
+	if(void *p = malloc(sz ? sz : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+}
+
+namespace config {
+
+	long iterations = 20000;
+	const char *filter = nullptr;
+
+	int argc;
+	char **argv;
+
+	void usage() {
+
+		std::string prog = basename(argv[0]);
+
+		std::cout << std::endl << "usage: " << prog << " [options]" << std::endl << std::endl;
+
+		std::cout << "\t-h          show this help" << std::endl;
+		std::cout << "\t-n count    iterations per benchmark (default=" << iterations << ")" << std::endl;
+		std::cout << "\t-f name     only run benchmarks whose name contains name" << std::endl;
+
+		std::cout << std::endl;
+	}
+
+	void init(int my_argc, char **my_argv) {
+
+		argc = my_argc;
+		argv = my_argv;
+	}
+
+	bool parse() {
+
+		int opt;
+
+		while((opt = getopt(argc, argv, "hn:f:")) != -1) {
+
+			switch(opt) {
+
+				case 'n': iterations = std::max(1L, atol(optarg)); break;
+				case 'f': filter = optarg; break;
+
+				case 'h':
+				default:
+						  return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+namespace sample {
+
+	const std::string track1 = "%B4111111111111111^DOE/JOHN^25121010000000000000?";
+	const std::string track2 = ";4111111111111111=25121010000000000000?";
+	const std::string track3 = "\033+";
+
+	const std::string read_frame = "\033s\033\1" + track1 + "\033\2" + track2 + "\033\3" + track3 + "?\034\0330";
+
+	std::string raw_track(size_t n) {
+		std::string s;
+		for(size_t i = 0; i < n; i++)
+			s.push_back(i & 1 ? 0x55 : 0x2a);
+		return s;
+	}
+
+	const std::string raw1 = raw_track(37);
+	const std::string raw2 = raw_track(25);
+
+	const std::string rawrd_frame =
+		"\033s\033\1" + std::string(1, (char)raw1.length()) + raw1 +
+		"\033\2" + std::string(1, (char)raw2.length()) + raw2 +
+		"\033\3" + std::string(1, '\0') + "?\034\0330";
+
+	const std::string write_frame = "\0330";
+
+	const std::string t2_line = "4111111111111111=25121010000000000000 and 5555444433332222=3001 trailing text\n";
+
+	const std::string block(1024, 'x');
+
+	std::string t2_file_text() {
+		std::string s;
+		while(s.length() < 64 * 1024)
+			s += "customer record without track data, account pending review\n" + t2_line;
+		return s;
+	}
+
+	const std::string t2_file = t2_file_text();
+}
+
+struct nullbuf : std::streambuf {
+	int overflow(int c) override { return c; }
+};
+
+struct device {
+
+	int sv[2];
+	int oob[2];
+	int null_fd;
+
+	jank::msr msr;
+
+	bool start() {
+
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+			return false;
+
+		if(pipe(oob) == -1)
+			return false;
+
+		null_fd = open("/dev/null", O_WRONLY);
+		if(null_fd == -1)
+			return false;
+
+		fcntl(sv[1], F_SETFL, O_NONBLOCK);
+
+		return msr.start(sv[0], oob[0], null_fd);
+	}
+
+	void feed(const std::string& s) {
+		::write(sv[1], s.c_str(), s.length());
+	}
+
+	void drain() {
+		char buf[4096];
+		while(::read(sv[1], buf, sizeof(buf)) > 0)
+			void();
+	}
+
+	void settle() {
+		char buf[4096];
+		while(recv(sv[0], buf, sizeof(buf), MSG_DONTWAIT) > 0)
+			void();
+		msr.flush();
+	}
+};
+
+template <class F> void bench(const char *name, F f) {
+
+	using clock_type = std::chrono::steady_clock;
+
+	if(config::filter != nullptr and strstr(name, config::filter) == nullptr)
+		return;
+
+	long warmup = std::min(config::iterations / 10 + 1, 1000L);
+
+	for(long n = 0; n < warmup; n++)
+		f(n);
+
+	auto allocs = counter::allocs;
+	auto t0 = clock_type::now();
+
+	for(long n = 0; n < config::iterations; n++)
+		f(n);
+
+	auto t1 = clock_type::now();
+
+	allocs = counter::allocs - allocs;
+
+	double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+	printf("%s\t%ld\t%.1f\t%.2f\n", name, config::iterations, ns / config::iterations, (double)allocs / config::iterations);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+
+	device dev;
+
+	nullbuf nb;
+
+	config::init(argc, argv);
+
+	if(not config::parse()) {
+		config::usage();
+		return EXIT_FAILURE;
+	}
+
+	if(not dev.start()) {
+		perror("device");
+		return EXIT_FAILURE;
+	}
+
+	auto& msr = dev.msr;
+
+	printf("#benchmark\titerations\tns/op\tallocs/op\n");
+
+	bench("msr::update", [&](long n) {
+		dev.feed(sample::block);
+		msr.sync();
+		if(n % 16 == 15)
+			msr.flush();
+	});
+
+	dev.settle();
+
+	bench("msr::read.parse", [&](long) {
+		std::string data;
+		dev.feed(sample::read_frame);
+		msr.read(data);
+		dev.drain();
+	});
+
+	bench("msr::read.split", [&](long) {
+		std::string t1, t2, t3;
+		dev.feed(sample::read_frame);
+		msr.read(t1, t2, t3);
+		dev.drain();
+	});
+
+	bench("msr::read.view", [&](long) {
+		std::array<jank::msr::view_type, 3> tracks;
+		dev.feed(sample::read_frame);
+		msr.read(tracks);
+		dev.drain();
+	});
+
+	bench("msr::rawrd.parse", [&](long) {
+		std::basic_string<unsigned char> data;
+		dev.feed(sample::rawrd_frame);
+		msr.rawrd(data);
+		dev.drain();
+	});
+
+	auto cout_buf = std::cout.rdbuf(&nb);
+
+	bench("msr::rawrd.split", [&](long) {
+		std::string t1, t2, t3;
+		dev.feed(sample::rawrd_frame);
+		msr.rawrd(t1, t2, t3);
+		dev.drain();
+	});
+
+	std::cout.rdbuf(cout_buf);
+
+	bench("msr::write", [&](long) {
+		dev.feed(sample::write_frame);
+		msr.write(sample::track1, sample::track2, "");
+		dev.drain();
+	});
+
+	dev.drain();
+
+	//
+	// the same parse over an in-memory loopback instead of a socket
+	//
+
+	jank::msr looped;
+
+	auto link = std::make_unique<jank::loopback>();
+	auto& peer = *link;
+
+	if(not looped.start(std::move(link), dev.oob[0], dev.null_fd)) {
+		perror("loopback");
+		return EXIT_FAILURE;
+	}
+
+	bench("msr::read.loopback", [&](long) {
+		std::string data;
+		peer.feed(sample::read_frame);
+		looped.read(data);
+		peer.consume(peer.sent().length());
+	});
+
+	//
+	// a steady stream of commands on one session; with the arena warm
+	// this should report no allocations at all
+	//
+
+	const std::string ack = "\033y";
+
+	bench("msr::steady.loopback", [&](long) {
+		std::array<jank::msr::view_type, 3> tracks;
+		peer.feed(sample::write_frame);
+		looped.write(sample::track1, sample::track2, "");
+		peer.feed(sample::read_frame);
+		looped.read(tracks);
+		peer.feed(ack);
+		looped.test_comm();
+		peer.consume(peer.sent().length());
+	});
+
+	//
+	// the first write on a fresh session, with the peer's buffers already
+	// grown, must not touch the global heap either; this is the check the
+	// allocation counter exists for, so it fails the run
+	//
+
+	{
+		jank::msr fresh;
+
+		auto link = std::make_unique<jank::loopback>();
+		auto& peer = *link;
+
+		std::string warm(4096, '\0');
+
+		peer.write(warm.data(), warm.length());
+		peer.consume(warm.length());
+		peer.feed(warm);
+		peer.discard();
+
+		if(not fresh.start(std::move(link), dev.oob[0], dev.null_fd)) {
+			perror("loopback");
+			return EXIT_FAILURE;
+		}
+
+		peer.feed(sample::write_frame);
+
+		auto allocs = counter::allocs;
+		bool ok = fresh.write(sample::track1, sample::track2, "");
+		allocs = counter::allocs - allocs;
+
+		printf("#check\tmsr::write.first\tok=%d\tallocs=%lu\n", ok, allocs);
+
+		if(allocs != 0)
+			return EXIT_FAILURE;
+	}
+
+	auto arena = looped.arena();
+
+	if(arena.commands > 0)
+		printf("#arena\tcommands=%lu\tspills=%lu\tspill_bytes=%lu\n", arena.commands, arena.spills, arena.spill_bytes);
+
+	bench("msr::hex", [&](long) {
+		auto s = msr.hex(sample::read_frame);
+	});
+
+	char trace[jank::dump_size(512, jank::dump_style::ansi)];
+
+	bench("dump.plain", [&](long) {
+		jank::dump(trace, sizeof(trace), sample::read_frame.data(), sample::read_frame.length(), jank::dump_style::plain);
+	});
+
+	bench("dump.ansi", [&](long) {
+		jank::dump(trace, sizeof(trace), sample::read_frame.data(), sample::read_frame.length(), jank::dump_style::ansi);
+	});
+
+	bench("dump.machine", [&](long) {
+		jank::dump(trace, sizeof(trace), sample::read_frame.data(), sample::read_frame.length(), jank::dump_style::machine);
+	});
+
+	bench("format_read", [&](long) {
+		auto s = jank::format_read("%a %0m/%y %c%y %B %; %%", sample::track1, sample::track2);
+	});
+
+	jank::format_program program("%a %0m/%y %c%y %B %; %%");
+
+	bench("format_program", [&](long) {
+		auto& s = program.apply(sample::track1, sample::track2);
+		(void)s;
+	});
+
+	bench("scan_track2", [&](long) {
+		auto matches = jank::scan_track2(sample::t2_line);
+	});
+
+	bench("find_track2.64k", [&](long) {
+		size_t length;
+		for(size_t pos = 0; (pos = jank::find_track2(sample::t2_file, pos, length)) != std::string_view::npos; pos += length);
+	});
+
+	cout_buf = std::cout.rdbuf(&nb);
+
+	bench("print_nbit", [&](long) {
+		jank::print_nbit(1, sample::raw1, 7);
+	});
+
+	bench("print_track", [&](long) {
+		jank::print_track(1, sample::track1);
+	});
+
+	std::cout.rdbuf(cout_buf);
+
+	return EXIT_SUCCESS;
+}
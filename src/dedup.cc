@@ -0,0 +1,408 @@
+#include <string>
+
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <jank.hh>
+#include <dedup.hh>
+
+namespace jank {
+
+	static const char dedup_magic[8] = { 'J', 'A', 'N', 'K', 'D', 'U', 'P', '2' };
+
+	//
+	// seeds the second hash each entry is checked against
+	//
+
+	constexpr static uint64_t check_seed = 0x9e3779b97f4a7c15ULL;
+
+	static size_t table_bytes(size_t capacity) {
+		return sizeof(dedup::header) + capacity * sizeof(dedup::slot);
+	}
+
+	dedup::dedup() : fd(-1), head(nullptr), table(nullptr), mapped(0) {
+	}
+
+	dedup::~dedup() {
+		close();
+	}
+
+	bool dedup::map(size_t bytes) {
+
+		void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, fd == -1 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+
+		if(p == MAP_FAILED)
+			return false;
+
+		head = (header *)p;
+		table = (slot *)(head + 1);
+		mapped = bytes;
+
+		return true;
+	}
+
+	bool dedup::open(const char *path) {
+
+		struct stat sb;
+
+		if(head != nullptr) {
+			errno = EALREADY;
+			return false;
+		}
+
+		if(path == nullptr) {
+
+			fd = -1;
+
+			if(not map(table_bytes(initial_capacity)))
+				return false;
+
+		} else {
+
+			this->path = path;
+
+			fd = ::open(path, O_RDWR | O_CREAT, 0644);
+			if(fd == -1)
+				return false;
+
+			if(fstat(fd, &sb) == -1)
+				goto failure;
+
+			if(sb.st_size == 0) {
+
+				if(ftruncate(fd, table_bytes(initial_capacity)) == -1)
+					goto failure;
+
+				if(not map(table_bytes(initial_capacity)))
+					goto failure;
+
+			} else {
+
+				if((size_t)sb.st_size < sizeof(header) or not map(sb.st_size))
+					goto failure;
+
+				if(memcmp(head->magic, dedup_magic, sizeof(dedup_magic)) != 0 or head->capacity == 0 or (head->capacity & (head->capacity - 1)) != 0 or table_bytes(head->capacity) != mapped) {
+					errno = EPROTO;
+					goto failure;
+				}
+
+				return true;
+			}
+		}
+
+		memcpy(head->magic, dedup_magic, sizeof(dedup_magic));
+		head->capacity = initial_capacity;
+		head->count = 0;
+
+		return true;
+
+	failure:
+		int e = errno;
+		close();
+		errno = e;
+		return false;
+	}
+
+	bool dedup::close() {
+
+		if(head != nullptr)
+			munmap(head, mapped);
+
+		if(fd != -1)
+			::close(fd);
+
+		bool was_open = head != nullptr;
+
+		fd = -1;
+		head = nullptr;
+		table = nullptr;
+		mapped = 0;
+
+		path.clear();
+
+		return was_open;
+	}
+
+	size_t dedup::size() const {
+		return head ? head->count : 0;
+	}
+
+	size_t dedup::capacity() const {
+		return head ? head->capacity : 0;
+	}
+
+	std::string_view dedup::normalize(const std::string& s) {
+
+		if(s == track::empty or s == track::error)
+			return std::string_view();
+
+		std::string_view v(s);
+
+		while(not v.empty() and isspace(v.back()))
+			v.remove_suffix(1);
+
+		if(not v.empty() and v.back() == '?')
+			v.remove_suffix(1);
+
+		if(not v.empty() and (v.front() == '%' or v.front() == ';'))
+			v.remove_prefix(1);
+
+		return v;
+	}
+
+	static uint64_t mix(uint64_t h) {
+
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ULL;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+
+		return h ? h : 1;
+	}
+
+	static uint64_t fnv(uint64_t h, const void *p, size_t sz) {
+
+		for(size_t n = 0; n < sz; n++) {
+			h ^= ((const unsigned char *)p)[n];
+			h *= 0x100000001b3ULL;
+		}
+
+		return h;
+	}
+
+	//
+	// FNV-1a over the track number and contents, finished with the
+	// splitmix64 mixer; zero marks an unused slot
+	//
+
+	uint64_t dedup::key(int no, std::string_view data, uint64_t seed) {
+		return mix(fnv(0xcbf29ce484222325ULL ^ seed ^ (uint64_t)no, data.data(), data.length()));
+	}
+
+	//
+	// the whole record: each non-empty normalised track as its number,
+	// its length and its contents, so no two records share a key by
+	// moving data between tracks
+	//
+
+	uint64_t dedup::key(const std::string& t1, const std::string& t2, const std::string& t3, uint64_t seed) {
+
+		const std::string *tracks[] = { &t1, &t2, &t3 };
+
+		uint64_t h = 0xcbf29ce484222325ULL ^ seed ^ 0xff;
+
+		for(int no = 0; no < 3; no++) {
+
+			auto data = normalize(*tracks[no]);
+
+			if(data.empty())
+				continue;
+
+			uint8_t tag = no + 1;
+			uint32_t length = data.length();
+
+			h = fnv(h, &tag, sizeof(tag));
+			h = fnv(h, &length, sizeof(length));
+			h = fnv(h, data.data(), data.length());
+		}
+
+		return mix(h);
+	}
+
+	dedup::slot *dedup::find(uint64_t k, uint64_t c) const {
+
+		size_t mask = head->capacity - 1;
+		size_t i = k & mask;
+
+		while(table[i].key != 0 and (table[i].key != k or table[i].check != c))
+			i = (i + 1) & mask;
+
+		return &table[i];
+	}
+
+	dedup::slot *dedup::insert(uint64_t k, uint64_t c, uint32_t seq) {
+
+		if((head->count + 1) * 10 > head->capacity * 7 and not grow())
+			return nullptr;
+
+		slot *s = find(k, c);
+
+		if(s->key == 0) {
+			s->key = k;
+			s->check = c;
+			s->flags = 0;
+			s->seq = seq;
+			head->count++;
+		}
+
+		return s;
+	}
+
+	//
+	// a file-backed table grows into a new file renamed over the old one
+	// once it is complete and synced, so a crash leaves one or the other
+	//
+
+	bool dedup::grow() {
+
+		header *old_head = head;
+		slot *old_table = table;
+		size_t old_mapped = mapped;
+		int old_fd = fd;
+
+		size_t capacity = head->capacity * 2;
+
+		std::string tmp;
+
+		if(old_fd != -1) {
+
+			tmp = path + ".tmp";
+
+			fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if(fd == -1)
+				goto failure;
+
+			if(ftruncate(fd, table_bytes(capacity)) == -1)
+				goto failure;
+		}
+
+		if(not map(table_bytes(capacity)))
+			goto failure;
+
+		memcpy(head->magic, dedup_magic, sizeof(dedup_magic));
+		head->capacity = capacity;
+		head->count = old_head->count;
+
+		for(size_t i = 0; i < old_head->capacity; i++)
+			if(old_table[i].key != 0)
+				*find(old_table[i].key, old_table[i].check) = old_table[i];
+
+		if(fd != -1) {
+
+			if(msync(head, mapped, MS_SYNC) == -1 or fsync(fd) == -1)
+				goto failure;
+
+			if(rename(tmp.c_str(), path.c_str()) == -1)
+				goto failure;
+		}
+
+		munmap(old_head, old_mapped);
+
+		if(old_fd != -1)
+			::close(old_fd);
+
+		return true;
+
+	failure:
+		int e = errno;
+
+		if(head != nullptr and head != old_head)
+			munmap(head, mapped);
+
+		if(fd != -1 and fd != old_fd)
+			::close(fd);
+
+		if(not tmp.empty())
+			unlink(tmp.c_str());
+
+		head = old_head;
+		table = old_table;
+		mapped = old_mapped;
+		fd = old_fd;
+
+		errno = e;
+
+		return false;
+	}
+
+	//
+	// the record's own flags when the whole record is known, otherwise
+	// shared when one of its tracks appeared in another record; first is
+	// the sequence number of whichever entry matched
+	//
+
+	uint32_t dedup::lookup(const std::string& t1, const std::string& t2, const std::string& t3, uint32_t *first) const {
+
+		const std::string *tracks[] = { &t1, &t2, &t3 };
+
+		if(head == nullptr)
+			return 0;
+
+		if(normalize(t1).empty() and normalize(t2).empty() and normalize(t3).empty())
+			return 0;
+
+		slot *r = find(key(t1, t2, t3), key(t1, t2, t3, check_seed));
+
+		if(r->key != 0) {
+			if(first != nullptr)
+				*first = r->seq;
+			return r->flags;
+		}
+
+		for(int no = 0; no < 3; no++) {
+
+			auto data = normalize(*tracks[no]);
+
+			if(data.empty())
+				continue;
+
+			slot *s = find(key(no + 1, data), key(no + 1, data, check_seed));
+
+			if(s->key != 0) {
+				if(first != nullptr)
+					*first = s->seq;
+				return shared;
+			}
+		}
+
+		return 0;
+	}
+
+	//
+	// sets flags on the record and notes each of its tracks; returns the
+	// record's flags from before
+	//
+
+	uint32_t dedup::mark(const std::string& t1, const std::string& t2, const std::string& t3, uint32_t flags, uint32_t seq) {
+
+		const std::string *tracks[] = { &t1, &t2, &t3 };
+
+		if(head == nullptr)
+			return 0;
+
+		if(normalize(t1).empty() and normalize(t2).empty() and normalize(t3).empty())
+			return 0;
+
+		slot *r = insert(key(t1, t2, t3), key(t1, t2, t3, check_seed), seq);
+
+		if(r == nullptr)
+			return 0;
+
+		uint32_t prev = r->flags;
+
+		r->flags |= flags;
+
+		for(int no = 0; no < 3; no++) {
+
+			auto data = normalize(*tracks[no]);
+
+			if(data.empty())
+				continue;
+
+			slot *s = insert(key(no + 1, data), key(no + 1, data, check_seed), seq);
+
+			if(s == nullptr)
+				break;
+
+			s->flags |= seen;
+		}
+
+		return prev;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <cstdint>
+
+namespace jank {
+
+	//
+	// an open-addressed table, optionally kept in a file, with one entry
+	// per whole record (tracks tagged by number) deciding seen and encoded,
+	// and one per track that only hints a record shares a track with an
+	// earlier one; each entry carries a second, independent hash so a
+	// match is checked rather than taken on one 64-bit key
+	//
+
+	class dedup {
+
+		public:
+
+			enum flag : uint32_t { seen = 1, encoded = 2, shared = 4 };
+
+			struct slot {
+				uint64_t key;
+				uint64_t check;
+				uint32_t flags;
+				uint32_t seq;
+			};
+
+			struct header {
+				char magic[8];
+				uint64_t capacity;
+				uint64_t count;
+			};
+
+			constexpr static size_t initial_capacity = 1024;
+
+			bool open(const char * = nullptr);
+			bool close();
+
+			uint32_t lookup(const std::string&, const std::string&, const std::string&, uint32_t * = nullptr) const;
+			uint32_t mark(const std::string&, const std::string&, const std::string&, uint32_t, uint32_t);
+
+			size_t size() const;
+			size_t capacity() const;
+
+			static std::string_view normalize(const std::string&);
+			static uint64_t key(int, std::string_view, uint64_t = 0);
+			static uint64_t key(const std::string&, const std::string&, const std::string&, uint64_t = 0);
+
+			dedup();
+			~dedup();
+
+		private:
+
+			int fd;
+
+			std::string path;
+
+			header *head;
+			slot *table;
+
+			size_t mapped;
+
+			slot *find(uint64_t, uint64_t) const;
+			slot *insert(uint64_t, uint64_t, uint32_t);
+			bool map(size_t);
+			bool grow();
+	};
+}
@@ -0,0 +1,289 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <jank.hh>
+#include <emu.hh>
+#include <batch.hh>
+#include <retry.hh>
+
+namespace config {
+
+	bool verbose = false;
+	long cards = 10;
+	long baud = 9600;
+	bool low_latency = false;
+	int retries = 3;
+	long sync_timeout = 30;
+	unsigned long seed = 1;
+	const char *workflow = nullptr;
+	jank::batch::verify_mode verify = jank::batch::verify_mode::none;
+
+	int argc;
+	char **argv;
+
+	jank::emu emu;
+
+	void usage() {
+
+		std::string prog = basename(argv[0]);
+
+		std::cout << std::endl << "usage: " << prog << " [options]" << std::endl << std::endl;
+
+		std::cout << "\t-h          show this help" << std::endl;
+		std::cout << "\t-v          toggle verbose mode (default="   << (verbose ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-n count    cards per workflow (default=" << cards << ")" << std::endl;
+		std::cout << "\t-w name     only run workflows whose name contains name" << std::endl;
+		std::cout << "\t-B baud     emulated line rate, 0 for none (default=" << baud << ")" << std::endl;
+		std::cout << "\t-y          toggle low-latency serial mode (default=" << (low_latency ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-s msec     emulated swipe delay (default=" << emu.swipe_delay << ")" << std::endl;
+		std::cout << "\t-e rate     swipe error probability (default=" << emu.error_rate << ")" << std::endl;
+		std::cout << "\t-T rate     reply truncation probability (default=" << emu.truncate_rate << ")" << std::endl;
+		std::cout << "\t-r count    automatic retries per card (default=" << retries << ")" << std::endl;
+		std::cout << "\t-V mode     verify writes with read or rawrd" << std::endl;
+		std::cout << "\t-t sec      msr sync timeout (default=" << sync_timeout << ")" << std::endl;
+		std::cout << "\t-S seed     random seed (default=" << seed << ")" << std::endl;
+
+		std::cout << std::endl;
+	}
+
+	void init(int my_argc, char **my_argv) {
+
+		argc = my_argc;
+		argv = my_argv;
+
+		emu.swipe_delay = 1200;
+		emu.error_rate = 0.05;
+	}
+
+	bool parse() {
+
+		int opt;
+
+		while((opt = getopt(argc, argv, "hvyn:w:B:s:e:T:r:V:t:S:")) != -1) {
+
+			switch(opt) {
+
+				case 'v': verbose = not verbose ; break;
+				case 'n': cards = std::max(1L, atol(optarg)); break;
+				case 'w': workflow = optarg; break;
+				case 'B': baud = atol(optarg); break;
+				case 'y': low_latency = not low_latency ; break;
+				case 's': emu.swipe_delay = atol(optarg); break;
+				case 'e': emu.error_rate = atof(optarg); break;
+				case 'T': emu.truncate_rate = atof(optarg); break;
+				case 'r': retries = atoi(optarg); break;
+				case 'V':
+					if(strcmp(optarg, "read") == 0)
+						verify = jank::batch::verify_mode::read;
+					else if(strcmp(optarg, "rawrd") == 0)
+						verify = jank::batch::verify_mode::rawrd;
+					else
+						return false;
+					break;
+				case 't': sync_timeout = std::max(1L, atol(optarg)); break;
+				case 'S': seed = strtoul(optarg, nullptr, 0); break;
+
+				case 'h':
+				default:
+						  return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+struct nullbuf : std::streambuf {
+	int overflow(int c) override { return c; }
+};
+
+//
+// synthetic batch files in the layouts the T12/T1T2 and T2 commands expect
+//
+
+FILE *records(bool tabbed) {
+
+	FILE *f = tmpfile();
+
+	if(f == nullptr)
+		return nullptr;
+
+	for(long n = 0; n < config::cards; n++) {
+
+		char pan[32];
+
+		snprintf(pan, sizeof(pan), "4%015ld", 111111111111111L + n);
+
+		if(tabbed)
+			fprintf(f, "B%s^CARDHOLDER/TEST^2512101000000\t%s=25121010000000\n", pan, pan);
+		else
+			fprintf(f, "record %ld %s=25121010000000\n", n, pan);
+	}
+
+	rewind(f);
+
+	return f;
+}
+
+void report(const char *name, const jank::batch::stats& st, const jank::retry_policy& policy, const jank::msr::io_stats& io) {
+	printf("%s\t%lu\t%lu\t%lu\t%lu\t%.2f\t%.4f\t%.4f\t%.4f\t%.1f\t%.1f\t%.1f\t%.1f\t%.3f\t%.2f\n",
+		name, st.cards, st.records, st.attempts, st.failures, st.cards_per_minute(),
+		st.device.count(), st.host().count(), st.sleep.count(),
+		st.percentile(0.5), st.percentile(0.9), st.percentile(0.99), st.percentile(1.0),
+		policy.st.yield(), io.per_response());
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+
+	auto& emu = config::emu;
+
+	jank::msr msr;
+
+	nullbuf nb;
+
+	int oob[2];
+	int null_fd;
+	int err_fd;
+
+	config::init(argc, argv);
+
+	if(not config::parse()) {
+		config::usage();
+		return EXIT_FAILURE;
+	}
+
+	emu.byte_delay = config::baud > 0 ? 10000000L / config::baud : 0;
+
+	if(not emu.start(config::seed)) {
+		perror("emu");
+		return EXIT_FAILURE;
+	}
+
+	std::thread device([&] { emu.run(); });
+
+	null_fd = open("/dev/null", O_WRONLY);
+
+	if(null_fd == -1 or pipe(oob) == -1) {
+		perror("open");
+		return EXIT_FAILURE;
+	}
+
+	msr.low_latency = config::low_latency;
+	msr.messages.threshold = config::verbose ? jank::logger::level::trace : jank::logger::level::off;
+
+	if(not msr.start(emu.device.c_str(), oob[0], config::verbose ? STDOUT_FILENO : null_fd)) {
+		perror("msr");
+		return EXIT_FAILURE;
+	}
+
+	msr.sync_timeout = config::sync_timeout;
+
+	msr.reset();
+	msr.set_hico();
+
+	err_fd = dup(STDERR_FILENO);
+
+	auto cout_buf = std::cout.rdbuf();
+
+	printf("#workflow\tcards\trecords\tattempts\tfailures\tcards/min\tdevice_s\thost_s\tsleep_s\tp50_ms\tp90_ms\tp99_ms\tmax_ms\tyield\twakeups/resp\n");
+	fflush(stdout);
+
+	auto run = [&](const char *name, auto f) {
+
+		if(config::workflow != nullptr and strstr(name, config::workflow) == nullptr)
+			return;
+
+		jank::batch b(msr);
+
+		jank::retry_policy policy;
+
+		for(auto f : { jank::retry_policy::failure::swipe, jank::retry_policy::failure::media, jank::retry_policy::failure::protocol })
+			policy.rules[(size_t)f].limit = config::retries;
+
+		b.limit = config::cards;
+		b.policy = &policy;
+		b.verify = config::verify;
+
+		msr.io = jank::msr::io_stats{};
+
+		if(not config::verbose) {
+			std::cout.rdbuf(&nb);
+			dup2(null_fd, STDERR_FILENO);
+		}
+
+		f(b);
+
+		std::cout.rdbuf(cout_buf);
+		dup2(err_fd, STDERR_FILENO);
+
+		report(name, b.st, policy, msr.io);
+	};
+
+	run("T12", [](jank::batch& b) {
+		if(FILE *f = records(true)) {
+			b.t12(fileno(f), 1);
+			fclose(f);
+		}
+	});
+
+	run("T1T2", [](jank::batch& b) {
+		if(FILE *f = records(true)) {
+			b.t1t2(fileno(f), 1);
+			fclose(f);
+		}
+	});
+
+	run("T2", [](jank::batch& b) {
+		if(FILE *f = records(false)) {
+			b.t2(fileno(f), 1);
+			fclose(f);
+		}
+	});
+
+	run("JOB", [](jank::batch& b) {
+		if(FILE *f = tmpfile()) {
+			for(long n = 0; n < config::cards; n++) {
+				char pan[32];
+				snprintf(pan, sizeof(pan), "4%015ld", 111111111111111L + n);
+				fprintf(f, "B%s^CARDHOLDER/TEST^2512101000000\t%s=25121010000000\t\t%s\n", pan, pan, n % 2 ? "loco" : "hico");
+			}
+			rewind(f);
+			b.job(fileno(f), true, true);
+			fclose(f);
+		}
+	});
+
+	run("READ", [](jank::batch& b) {
+		b.read();
+	});
+
+	run("ERASE", [](jank::batch& b) {
+		for(long cards = b.limit; (long)b.st.records < cards; ) {
+			b.limit = cards - b.st.records;
+			b.erase(true, true, true);
+		}
+	});
+
+	msr.stop();
+
+	emu.halt();
+	device.join();
+
+	if(config::verbose) {
+		std::cout << "commands="    << emu.stats.commands    << std::endl;
+		std::cout << "swipes="      << emu.stats.swipes      << std::endl;
+		std::cout << "errors="      << emu.stats.errors      << std::endl;
+		std::cout << "truncations=" << emu.stats.truncations << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,491 @@
+#include <string>
+#include <sstream>
+#include <thread>
+
+#include <cstring>
+#include <cstdlib>
+
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <emu.hh>
+
+#define ESC "\033"
+#define FS "\034"
+
+namespace jank {
+
+	emu::emu() : byte_delay(0), swipe_delay(0), error_rate(0), error_status('1'), truncate_rate(0), model_id('3'), firmware("REVH1.10"), hico(true), msg_fd(-1), master_fd(-1), slave_fd(-1), running(false), led(0) {
+		memset(&stats, 0, sizeof(stats));
+		pending.what = op::none;
+		pending.mask = 0;
+	}
+
+	emu::~emu() {
+		stop();
+	}
+
+	bool emu::start(unsigned long seed) {
+
+		termios options;
+
+		if(master_fd != -1) {
+			errno = EALREADY;
+			return false;
+		}
+
+		rng.seed(seed);
+
+		master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if(master_fd == -1)
+			return false;
+
+		if(grantpt(master_fd) == -1 or unlockpt(master_fd) == -1)
+			goto failure;
+
+		device = ptsname(master_fd);
+
+		//
+		// keep the slave open ourselves so the master never sees EIO
+		// between driver sessions, and start it out in raw mode
+		//
+
+		slave_fd = open(device.c_str(), O_RDWR | O_NOCTTY);
+		if(slave_fd == -1)
+			goto failure;
+
+		if(tcgetattr(slave_fd, &options) == -1)
+			goto failure;
+
+		cfmakeraw(&options);
+
+		if(tcsetattr(slave_fd, TCSANOW, &options) == -1)
+			goto failure;
+
+		message("START " + device);
+
+		running = true;
+
+		return true;
+
+	failure:
+		int e = errno;
+		stop();
+		errno = e;
+		return false;
+	}
+
+	bool emu::stop() {
+
+		if(master_fd == -1) {
+			errno = ENOMEDIUM;
+			return false;
+		}
+
+		if(slave_fd != -1)
+			close(slave_fd);
+
+		close(master_fd);
+
+		master_fd = -1;
+		slave_fd = -1;
+
+		rx.clear();
+		pending.what = op::none;
+
+		return true;
+	}
+
+	void emu::halt() {
+		running = false;
+	}
+
+	bool emu::run() {
+
+		while(running)
+			if(not step(100))
+				return false;
+
+		return true;
+	}
+
+	bool emu::step(long timeout) {
+
+		char block[1024];
+
+		pollfd pfd = { master_fd, POLLIN, 0 };
+
+		if(pending.what != op::none) {
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(pending.due - clock_type::now()).count();
+			timeout = std::max(0L, std::min(timeout, (long)left + 1));
+		}
+
+		int n = poll(&pfd, 1, timeout);
+		if(n == -1)
+			return errno == EINTR;
+
+		if(n > 0 and (pfd.revents & POLLIN)) {
+
+			ssize_t m = ::read(master_fd, block, sizeof(block));
+			if(m == -1)
+				return errno == EINTR or errno == EAGAIN;
+
+			rx.append(block, m);
+			stats.bytes_in += m;
+		}
+
+		if(pending.what != op::none and clock_type::now() >= pending.due)
+			if(not complete())
+				return false;
+
+		return process();
+	}
+
+	void emu::message(const std::string& msg) const {
+		if(msg_fd != -1) {
+			std::string s = "[" + msg + "]\n";
+			::write(msg_fd, s.c_str(), s.length());
+		}
+	}
+
+	bool emu::inject(double rate) {
+		return rate > 0 and std::bernoulli_distribution(std::min(rate, 1.0))(rng);
+	}
+
+	bool emu::process() {
+		while(dispatch())
+			void();
+		return true;
+	}
+
+	bool emu::dispatch() {
+
+		auto esc = rx.find('\033');
+
+		rx.erase(0, esc);
+
+		if(rx.length() < 2)
+			return false;
+
+		unsigned char cmd = rx[1];
+
+		//
+		// reset and the LED commands are honoured immediately, everything
+		// else queues up behind a pending swipe
+		//
+
+		if(cmd == 'a') {
+			message("RESET");
+			stats.commands++;
+			pending.what = op::none;
+			rx.erase(0, 2);
+			return true;
+		}
+
+		if(cmd >= 0x81 and cmd <= 0x85) {
+			stats.commands++;
+			led = cmd;
+			rx.erase(0, 2);
+			return true;
+		}
+
+		if(pending.what != op::none)
+			return false;
+
+		auto swipe = [this](op what) {
+			pending.what = what;
+			pending.due = clock_type::now() + std::chrono::milliseconds(swipe_delay);
+		};
+
+		switch(cmd) {
+
+			case 'e':
+				rx.erase(0, 2);
+				reply(ESC "y");
+				break;
+
+			case 't':
+				rx.erase(0, 2);
+				reply(ESC + std::string(1, model_id) + "S");
+				break;
+
+			case 'v':
+				rx.erase(0, 2);
+				reply(ESC + firmware);
+				break;
+
+			case 'x':
+			case 'y':
+				rx.erase(0, 2);
+				hico = (cmd == 'x');
+				reply_status('0');
+				break;
+
+			case 'd':
+				rx.erase(0, 2);
+				reply(hico ? ESC "h" : ESC "l");
+				break;
+
+			case 0x87:
+				rx.erase(0, 2);
+				reply_status('0');
+				break;
+
+			case 0x86:
+				rx.erase(0, 2);
+				swipe(op::sensor);
+				break;
+
+			case 'r':
+				rx.erase(0, 2);
+				swipe(op::read);
+				break;
+
+			case 'm':
+				rx.erase(0, 2);
+				swipe(op::rawrd);
+				break;
+
+			case 'c':
+				if(rx.length() < 3)
+					return false;
+				pending.mask = rx[2] == 0 ? 1 : rx[2];
+				rx.erase(0, 3);
+				swipe(op::erase);
+				break;
+
+			case 'w': {
+
+				auto fs = rx.find('\034', 2);
+				if(fs == std::string::npos)
+					return false;
+
+				if(rx.compare(2, 2, ESC "s") != 0) {
+					rx.erase(0, fs + 1);
+					reply_status('2');
+					break;
+				}
+
+				std::string body = rx.substr(4, fs - 4);
+
+				rx.erase(0, fs + 1);
+
+				if(not body.empty() and body.back() == '?')
+					body.pop_back();
+
+				for(int no = 0; no < 3; no++) {
+					const char mark[] = { '\033', (char)(no + 1), '\0' };
+					auto b = body.find(mark);
+					pending.tracks[no].clear();
+					if(b != std::string::npos) {
+						b += 2;
+						auto e = body.find('\033', b);
+						pending.tracks[no] = normalize(body.substr(b, e == std::string::npos ? e : e - b));
+					}
+				}
+
+				swipe(op::write);
+				break;
+			}
+
+			default:
+				rx.erase(0, 2);
+				reply_status('4');
+				break;
+		}
+
+		stats.commands++;
+
+		return true;
+	}
+
+	bool emu::complete() {
+
+		op what = pending.what;
+
+		pending.what = op::none;
+
+		stats.swipes++;
+
+		bool fail = inject(error_rate);
+
+		if(fail)
+			stats.errors++;
+
+		std::string frame;
+
+		switch(what) {
+
+			case op::read:
+				message("SWIPE READ");
+				frame = fail ? ESC "s" ESC "\1" ESC "*" ESC "\2" ESC "*" ESC "\3" ESC "*" "?" FS : read_frame();
+				frame += ESC + std::string(1, fail ? error_status : '0');
+				break;
+
+			case op::rawrd:
+				message("SWIPE RAWREAD");
+				frame = fail ? std::string(ESC "s" ESC "\1\0" ESC "\2\0" ESC "\3\0" "?" FS, 13) : rawrd_frame();
+				frame += ESC + std::string(1, fail ? error_status : '0');
+				break;
+
+			case op::write:
+				message("SWIPE WRITE");
+				if(not fail) {
+					if(not pending.tracks[0].empty()) track1 = pending.tracks[0];
+					if(not pending.tracks[1].empty()) track2 = pending.tracks[1];
+					if(not pending.tracks[2].empty()) track3 = pending.tracks[2];
+				}
+				frame = ESC + std::string(1, fail ? error_status : '0');
+				break;
+
+			case op::erase:
+				message("SWIPE ERASE");
+				if(not fail) {
+					if(pending.mask & 1) track1.clear();
+					if(pending.mask & 2) track2.clear();
+					if(pending.mask & 4) track3.clear();
+				}
+				frame = fail ? ESC "A" : ESC "0";
+				break;
+
+			case op::sensor:
+				message("SWIPE SENSOR");
+				frame = ESC "0";
+				break;
+
+			case op::none:
+				return true;
+		}
+
+		if(inject(truncate_rate)) {
+			stats.truncations++;
+			frame.resize(std::uniform_int_distribution<size_t>(1, frame.length() - 1)(rng));
+			message("TRUNCATE");
+		}
+
+		return reply(frame);
+	}
+
+	bool emu::reply_status(char status) {
+		return reply(ESC + std::string(1, status));
+	}
+
+	bool emu::reply(const std::string& s) {
+
+		size_t done = 0;
+		size_t step = byte_delay > 0 ? 1 : s.length();
+
+		while(done < s.length()) {
+
+			if(byte_delay > 0)
+				std::this_thread::sleep_for(std::chrono::microseconds(byte_delay));
+
+			ssize_t n = ::write(master_fd, s.c_str() + done, std::min(step, s.length() - done));
+
+			if(n == -1) {
+				if(errno == EINTR or errno == EAGAIN)
+					continue;
+				return false;
+			}
+
+			done += n;
+			stats.bytes_out += n;
+		}
+
+		return true;
+	}
+
+	std::string emu::normalize(const std::string& s) {
+
+		if(s == ESC "+" or s == ESC "*")
+			return "";
+
+		auto b = s.begin();
+		auto e = s.end();
+
+		if(b != e and (*b == '%' or *b == ';'))
+			b++;
+		if(b != e and *std::prev(e) == '?')
+			e--;
+
+		return std::string(b, e);
+	}
+
+	std::string emu::read_frame() const {
+
+		const std::string *tracks[] = { &track1, &track2, &track3 };
+
+		std::string s = ESC "s";
+
+		for(int no = 0; no < 3; no++) {
+			auto t = normalize(*tracks[no]);
+			s += '\033';
+			s += (char)(no + 1);
+			s += t.empty() ? ESC "+" : (no == 0 ? "%" : ";") + t + "?";
+		}
+
+		return s + "?" FS;
+	}
+
+	std::string emu::rawrd_frame() const {
+
+		const std::string *tracks[] = { &track1, &track2, &track3 };
+
+		std::string s = ESC "s";
+
+		for(int no = 0; no < 3; no++) {
+			auto t = normalize(*tracks[no]);
+			auto raw = t.empty() ? "" : encode((no == 0 ? "%" : ";") + t + "?", no == 0 ? 7 : 5);
+			s += '\033';
+			s += (char)(no + 1);
+			s += (char)std::min(raw.length(), (size_t)255);
+			s.append(raw, 0, 255);
+		}
+
+		return s + "?" FS;
+	}
+
+	//
+	// ISO 7811 style bit packing: each symbol is sent LSB first followed by
+	// an odd parity bit, terminated by an LRC symbol, packed MSB first
+	//
+
+	std::string emu::encode(const std::string& text, int bits) {
+
+		const int base = bits == 5 ? '0' : ' ';
+		const int mask = (1 << (bits - 1)) - 1;
+
+		std::string out;
+
+		int lrc = 0;
+		int acc = 0;
+		int nacc = 0;
+
+		auto emit = [&](int v) {
+			int ones = 0;
+			for(int b = 0; b < bits - 1; b++) {
+				int bit = (v >> b) & 1;
+				ones += bit;
+				acc = (acc << 1) | bit;
+				if(++nacc == 8) { out.push_back((char)acc); acc = nacc = 0; }
+			}
+			acc = (acc << 1) | (ones & 1 ? 0 : 1);
+			if(++nacc == 8) { out.push_back((char)acc); acc = nacc = 0; }
+		};
+
+		for(char ch : text) {
+			int v = (ch - base) & mask;
+			lrc ^= v;
+			emit(v);
+		}
+
+		emit(lrc);
+
+		if(nacc > 0)
+			out.push_back((char)(acc << (8 - nacc)));
+
+		return out;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <random>
+#include <atomic>
+#include <chrono>
+
+namespace jank {
+
+	class emu {
+
+		public:
+
+			using clock_type = std::chrono::steady_clock;
+
+			struct counters {
+				unsigned long commands;
+				unsigned long swipes;
+				unsigned long errors;
+				unsigned long truncations;
+				unsigned long bytes_in;
+				unsigned long bytes_out;
+			};
+
+			std::string device;
+
+			long byte_delay;
+			long swipe_delay;
+
+			double error_rate;
+			char error_status;
+
+			double truncate_rate;
+
+			char model_id;
+			std::string firmware;
+
+			std::string track1;
+			std::string track2;
+			std::string track3;
+
+			bool hico;
+
+			int msg_fd;
+
+			counters stats;
+
+			bool start(unsigned long);
+			bool stop();
+
+			bool run();
+			bool step(long);
+			void halt();
+
+			emu();
+			~emu();
+
+		private:
+
+			enum class op { none, read, rawrd, write, erase, sensor };
+
+			int master_fd;
+			int slave_fd;
+
+			std::atomic<bool> running;
+
+			std::mt19937 rng;
+
+			std::string rx;
+
+			struct {
+				op what;
+				std::string tracks[3];
+				char mask;
+				clock_type::time_point due;
+			} pending;
+
+			char led;
+
+			void message(const std::string&) const;
+
+			bool process();
+			bool dispatch();
+			bool complete();
+
+			bool inject(double);
+
+			bool reply(const std::string&);
+			bool reply_status(char);
+
+			std::string read_frame() const;
+			std::string rawrd_frame() const;
+
+			static std::string normalize(const std::string&);
+			static std::string encode(const std::string&, int);
+	};
+}
@@ -0,0 +1,443 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <array>
+
+#include <cstring>
+#include <cstdio>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <jank.hh>
+#include <format.hh>
+
+using namespace std::literals::string_literals;
+
+namespace jank {
+
+	format_program::format_program(const char *fmts) {
+
+		const char *p = fmts;
+
+		while(*p != '\0') {
+
+			const char *q = strchr(p, '%');
+
+			if(q == nullptr) {
+				literal(p, strlen(p));
+				break;
+			}
+
+			literal(p, q - p);
+
+			p = q + 1;
+
+			if(*p == '\0') {
+				literal("%", 1);
+				break;
+			}
+
+			bool _0_ = (*p == '0');
+			if(_0_ and *++p == '\0')
+				break;
+
+			switch(*p++) {
+				case 'c': program.push_back({ field::century, 0, 0 }); break;
+				case 'y': program.push_back({ _0_ ? field::year0 : field::year, 0, 0 }); break;
+				case 'm': program.push_back({ _0_ ? field::month0 : field::month, 0, 0 }); break;
+				case 'a': program.push_back({ field::account, 0, 0 }); break;
+				case 'B': program.push_back({ field::track1, 0, 0 }); break;
+				case ';': program.push_back({ field::track2, 0, 0 }); break;
+				case '%': literal("%", 1); break;
+			}
+		}
+	}
+
+	void format_program::literal(const char *p, size_t n) {
+
+		if(n == 0)
+			return;
+
+		if(not program.empty() and program.back().what == field::literal and program.back().offset + program.back().length == literals.length()) {
+			program.back().length += n;
+		} else {
+			program.push_back({ field::literal, (uint32_t)literals.length(), (uint32_t)n });
+		}
+
+		literals.append(p, n);
+	}
+
+	const std::vector<format_program::op>& format_program::ops() const {
+		return program;
+	}
+
+	const std::string& format_program::apply(std::string_view t1, std::string_view t2) {
+		apply(t1, t2, output);
+		return output;
+	}
+
+	void format_program::apply(std::string_view t1, std::string_view t2, std::string& out) const {
+
+		auto is_ok = [](std::string_view t) { return t != jank::track::empty and t != jank::track::error; };
+
+		std::string_view _B_ = is_ok(t1) ? t1 : "-";
+		std::string_view st2 = is_ok(t2) ? t2 : "-";
+		std::string_view _a_, _0y_, _y_, _0m_, _m_, _c_;
+
+		if(not st2.empty() and st2.front() == ';') {
+			size_t ae = st2.find('=', 1);
+			if(ae != std::string_view::npos) {
+				_a_ = st2.substr(1, ae - 1);
+				if(st2.length() - (ae + 1) >= 4) {
+					_c_ = "20";
+					_0y_ = st2.substr(ae + 1, 2);
+					_0m_ = st2.substr(ae + 3, 2);
+					_y_ = _0y_.front() == '0' ? _0y_.substr(1) : _0y_;
+					_m_ = _0m_.front() == '0' ? _0m_.substr(1) : _0m_;
+				}
+			}
+		}
+
+		out.clear();
+
+		for(const op& o : program) {
+			switch(o.what) {
+				case field::literal: out.append(literals, o.offset, o.length); break;
+				case field::century: out.append(_c_); break;
+				case field::year:    out.append(_y_); break;
+				case field::year0:   out.append(_0y_); break;
+				case field::month:   out.append(_m_); break;
+				case field::month0:  out.append(_0m_); break;
+				case field::account: out.append(_a_); break;
+				case field::track1:  out.append(_B_); break;
+				case field::track2:  out.append(st2); break;
+			}
+		}
+	}
+
+	//
+	// what each byte prints as: printable ASCII as itself, NUL, ESC and FS
+	// by name, the other controls below ESC as ^A..^Z and anything else as
+	// hex; controls and hex are marked, \x in plain and bold in ANSI
+	//
+
+	struct glyph {
+		uint8_t length;
+		char text[15];
+	};
+
+	using glyph_table = std::array<glyph, 256>;
+
+	static constexpr glyph_table make_glyphs(bool ansi) {
+
+		const char digits[] = "0123456789abcdef";
+
+		glyph_table table {};
+
+		for(int c = 0; c < 256; c++) {
+
+			char body[6] = {};
+			uint8_t n = 0;
+
+			auto put = [&](const char *s) {
+				while(*s)
+					body[n++] = *s++;
+			};
+
+			if(c > 0x20 and c < 0x7f) {
+				table[c].text[0] = (char)c;
+				table[c].length = 1;
+				continue;
+			}
+
+			if(c == 0x00) {
+				put("[NUL]");
+			} else if(c == 0x1b) {
+				put("[ESC]");
+			} else if(c == 0x1c) {
+				put("[FS]");
+			} else if(c < 0x1b) {
+				body[n++] = '^';
+				body[n++] = (char)(c + '@');
+			} else {
+				if(not ansi)
+					put("\\x");
+				body[n++] = digits[c >> 4];
+				body[n++] = digits[c & 15];
+			}
+
+			glyph& g = table[c];
+
+			auto emit = [&](const char *s, uint8_t len) {
+				for(uint8_t i = 0; i < len; i++)
+					g.text[g.length++] = s[i];
+			};
+
+			if(ansi)
+				emit("\033[1m", 4);
+
+			emit(body, n);
+
+			if(ansi)
+				emit("\033[0m", 4);
+		}
+
+		return table;
+	}
+
+	static constexpr glyph_table plain_glyphs = make_glyphs(false);
+	static constexpr glyph_table ansi_glyphs = make_glyphs(true);
+
+	//
+	// writes at most out_sz - 1 characters, stopping at a whole byte's
+	// text, then a NUL; returns the characters written
+	//
+
+	size_t dump(char *out, size_t out_sz, const void *data, size_t sz, dump_style style) {
+
+		const char digits[] = "0123456789abcdef";
+
+		auto p = (const unsigned char *)data;
+
+		if(out_sz == 0)
+			return 0;
+
+		char *o = out;
+		char *end = out + out_sz - 1;
+
+		if(style == dump_style::machine) {
+
+			o += std::min((size_t)std::max(snprintf(o, end - o + 1, "%zu:", sz), 0), (size_t)(end - o));
+
+			for(size_t n = 0; n < sz and end - o >= 2; n++) {
+				*o++ = digits[p[n] >> 4];
+				*o++ = digits[p[n] & 15];
+			}
+
+			*o = '\0';
+
+			return o - out;
+		}
+
+		const glyph_table& glyphs = style == dump_style::ansi ? ansi_glyphs : plain_glyphs;
+
+		o += std::min((size_t)std::max(snprintf(o, end - o + 1, "char s[%zu] = { ", sz), 0), (size_t)(end - o));
+
+		for(size_t n = 0; n < sz; n++) {
+
+			const glyph& g = glyphs[p[n]];
+
+			if(end - o < (ptrdiff_t)sizeof(g.text)) {
+				if(end - o < g.length)
+					break;
+				memcpy(o, g.text, g.length);
+			} else {
+				memcpy(o, g.text, sizeof(g.text));
+			}
+
+			o += g.length;
+		}
+
+		if(end - o >= 3) {
+			memcpy(o, " };", 3);
+			o += 3;
+		}
+
+		*o = '\0';
+
+		return o - out;
+	}
+
+	std::string format_read(const char *fmts, const std::string& t1, const std::string& t2) {
+		std::string s;
+		format_program(fmts).apply(t1, t2, s);
+		return s;
+	}
+
+	std::string binary(const std::string& s) {
+		std::string t;
+		for(int i = 0; i < (int)s.length(); i++) {
+			unsigned char ch = (unsigned char)s[i];
+			for(int b = 7; b >= 0; b--)
+				t.push_back(ch & (1 << b) ? '1' : '0');
+		}
+
+		return t;
+	}
+
+	int charcount(const std::string& s, char ch) {
+		int num = 0;
+		for(char ds : s)
+			if(ds == ch)
+				num++;
+		return num;
+	}
+
+	void print_nbit(unsigned int track_no, const std::string& track, int num_bits) {
+		auto bits = binary(track);
+		std::cout << "track" << track_no << " (" << jank::track::status(track) << ") :: " << std::dec << ((int)track.length()) << ' ' << num_bits <<"-bit symbols :=";
+		if(jank::track::is_ok(track)) {
+			while(not bits.empty()) {
+				int min_bits = std::min(num_bits, (int)bits.length());
+				if(min_bits < 2)
+					break;
+				auto front = bits.substr(0, min_bits);
+				bits = bits.substr(min_bits, std::string::npos);
+				int parity0 = front.back() - '0';
+				front.pop_back();
+				std::reverse(front.begin(), front.end());
+				int parity1 = charcount(front,'1') & 1 ? 0 : 1;
+				int val = stoul(front, nullptr, 2);
+				char ch = val + (num_bits == 5 ? '0' : ' ');
+				if(parity0 == parity1)
+					std::cout << ch;
+				else
+					std::cout  << " \033[31m" << ch << "\033[0m";
+			}
+			std::cout << std::endl;
+		}
+		std::cout << std::endl;
+	}
+
+	//
+	// decodes raw track bits (bits - 1 data bits LSB first plus odd parity
+	// per character, leading clock zeros skipped) up to the end sentinel;
+	// true when every character's parity and the LRC that follows check
+	//
+
+	bool decode_track(const std::string& raw, int bits, std::string& text) {
+
+		const int base = bits == 5 ? '0' : ' ';
+		const int end_sentinel = '?' - base;
+
+		size_t nbits = raw.length() * 8;
+		size_t at = 0;
+
+		auto bit = [&](size_t k) { return ((unsigned char)raw[k / 8] >> (7 - k % 8)) & 1; };
+
+		text.clear();
+
+		while(at < nbits and bit(at) == 0)
+			at++;
+
+		int lrc = 0;
+		bool parity = true;
+		bool ended = false;
+
+		while(at + bits <= nbits) {
+
+			int v = 0;
+			int ones = 0;
+
+			for(int b = 0; b < bits - 1; b++) {
+				int x = bit(at + b);
+				v |= x << b;
+				ones += x;
+			}
+
+			ones += bit(at + bits - 1);
+
+			at += bits;
+
+			parity = parity and (ones & 1);
+
+			if(ended)
+				return parity and v == lrc;
+
+			lrc ^= v;
+
+			text.push_back((char)(v + base));
+
+			ended = (v == end_sentinel);
+		}
+
+		return false;
+	}
+
+	void print_track(unsigned int no, const std::string& track) {
+		std::cout << "track" << no << " (" << jank::track::status(track) << ')';
+		if(jank::track::is_ok(track))
+			std::cout << ' ' << track;
+		std::cout << std::endl;
+	}
+
+	static bool is_digit(char c) {
+		return c >= '0' and c <= '9';
+	}
+
+	static bool is_word(char c) {
+		return is_digit(c) or (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_';
+	}
+
+	//
+	// position of the next '=' in [p, end), sixteen bytes at a time
+	//
+
+	static const char *find_equals(const char *p, const char *end) {
+#ifdef __SSE2__
+		const __m128i eq = _mm_set1_epi8('=');
+
+		for(; end - p >= 16; p += 16) {
+			int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), eq));
+			if(mask != 0)
+				return p + __builtin_ctz(mask);
+		}
+#endif
+		const void *q = memchr(p, '=', end - p);
+
+		return q ? (const char *)q : end;
+	}
+
+	//
+	// same matches as \b\d{15,19}=\d{4,60}\b searched repeatedly from the
+	// end of the previous match: the digit run before '=' must start on a
+	// word boundary and the run after it must end on one
+	//
+
+	size_t find_track2(std::string_view text, size_t from, size_t& length) {
+
+		const char *base = text.data();
+		const char *end = base + text.length();
+		const char *p = base + std::min(from, text.length());
+		const char *floor = p;
+
+		while((p = find_equals(p, end)) != end) {
+
+			const char *eq = p++;
+			const char *a = eq;
+
+			while(a > floor and eq - a < 20 and is_digit(a[-1]))
+				a--;
+
+			if(eq - a < 15 or eq - a > 19 or (a > base and is_word(a[-1])))
+				continue;
+
+			const char *b = eq + 1;
+
+			while(b < end and b - eq <= 61 and is_digit(*b))
+				b++;
+
+			if(b - eq - 1 < 4 or b - eq - 1 > 60 or (b < end and is_word(*b)))
+				continue;
+
+			length = b - a;
+
+			return a - base;
+		}
+
+		return std::string_view::npos;
+	}
+
+	std::list<std::string> scan_track2(const std::string& line) {
+
+		std::list<std::string> matches;
+		size_t length;
+
+		for(size_t pos = 0; (pos = find_track2(line, pos, length)) != std::string_view::npos; pos += length)
+			matches.emplace_back(line, pos, length);
+
+		return matches;
+	}
+}
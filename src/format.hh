@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+
+#include <cstdint>
+
+namespace jank {
+
+	//
+	// a -r format string compiled once into a list of ops; apply() writes
+	// into a reusable buffer so per-card formatting does not reparse
+	//
+
+	class format_program {
+
+		public:
+
+			enum class field : unsigned char { literal, century, year, year0, month, month0, account, track1, track2 };
+
+			struct op {
+				field what;
+				uint32_t offset;
+				uint32_t length;
+			};
+
+			format_program(const char *);
+
+			const std::string& apply(std::string_view, std::string_view);
+			void apply(std::string_view, std::string_view, std::string&) const;
+
+			const std::vector<op>& ops() const;
+
+		private:
+
+			std::vector<op> program;
+			std::string literals;
+			std::string output;
+
+			void literal(const char *, size_t);
+	};
+
+	//
+	// byte dumps for traces, one table lookup per byte into the caller's
+	// buffer: plain text, the same with ANSI bold on the control bytes, or
+	// machine output of the length, a colon and lowercase hex
+	//
+
+	enum class dump_style : unsigned char { plain, ansi, machine };
+
+	constexpr size_t dump_size(size_t sz, dump_style style) {
+		return 48 + sz * (style == dump_style::ansi ? 13 : style == dump_style::plain ? 5 : 2);
+	}
+
+	size_t dump(char *, size_t, const void *, size_t, dump_style);
+
+	std::string format_read(const char *, const std::string&, const std::string&);
+
+	std::string binary(const std::string&);
+	int charcount(const std::string&, char);
+
+	bool decode_track(const std::string&, int, std::string&);
+
+	void print_track(unsigned int, const std::string&);
+	void print_nbit(unsigned int, const std::string&, int);
+
+	size_t find_track2(std::string_view, size_t, size_t&);
+	std::list<std::string> scan_track2(const std::string&);
+}
@@ -1,18 +1,20 @@
-#include <iomanip>
 #include <iostream>
-#include <sstream>
 #include <string>
-#include <regex>
 
 #include <cstring>
+#include <cstdio>
 #include <cctype>
 
 #include <termios.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/select.h>
+#include <poll.h>
 
 #include <jank.hh>
+#include <transport.hh>
+#include <format.hh>
+#include <model.hh>
 
 #define ESC "\033"
 
@@ -66,97 +68,193 @@ namespace jank {
 		return std::make_pair(jter == b.cend(), iter);
 	}
 
-	msr::msr() : active(false), sync_timeout(30), msr_errno(0) {
+	msr::msr(std::pmr::memory_resource *upstream) : active(false), sync_timeout(30), msr_errno(0), baud(default_baud), low_latency(false), reconnect_ms(0), io{}, trace(dump_style::ansi), spill(upstream), arena_block((std::byte *)upstream->allocate(arena_size, alignof(std::max_align_t))), scratch(arena_block, arena_size, &spill), arena_depth(0), arena_commands(0), state{}, restoring(false), resumed(0), retained(0) {
 			memset(&cache, 0, sizeof(cache));
 	}
 
+	counted_resource::counted_resource(std::pmr::memory_resource *my_upstream) : allocations(0), bytes(0), upstream(my_upstream) {
+	}
+
+	void *counted_resource::do_allocate(size_t sz, size_t align) {
+		allocations++;
+		bytes += sz;
+		return upstream->allocate(sz, align);
+	}
+
+	void counted_resource::do_deallocate(void *p, size_t sz, size_t align) {
+		upstream->deallocate(p, sz, align);
+	}
+
+	bool counted_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+		return this == &other;
+	}
+
+	msr::scope::scope(const msr& my_owner) : owner(my_owner) {
+		owner.arena_depth++;
+	}
+
+	msr::scope::~scope() {
+		if(--owner.arena_depth == 0) {
+			owner.scratch.release();
+			owner.arena_commands++;
+		}
+	}
+
+	msr::arena_stats msr::arena() const {
+		return { arena_commands, spill.allocations, spill.bytes };
+	}
+
+	double msr::io_stats::per_response() const {
+		return responses ? (double)wakeups / responses : 0.0;
+	}
+
 	msr::~msr() {
 			if(active) {
 					reset();
 					stop();
 			}
+			scratch.release();
+			spill.upstream->deallocate(arena_block, arena_size, alignof(std::max_align_t));
 	}
 
 	bool msr::start(const char *my_device, int my_oob_fd, int my_msg_fd) {
 
-		termios options;
-
 		if(active) {
 			errno = EALREADY;
 			return false;
 		}
 
+		auto my_link = transport::open(my_device);
+		if(my_link == nullptr)
+			return false;
+
+		if(not start(std::move(my_link), my_oob_fd, my_msg_fd))
+			return false;
+
 		device = my_device;
 
-		oob_fd = my_oob_fd;
-		msg_fd = my_msg_fd;
+		return true;
+	}
+
+	bool msr::start(int my_msr_fd, int my_oob_fd, int my_msg_fd) {
+
+		if(active) {
+			errno = EALREADY;
+			return false;
+		}
+
+		auto my_link = std::make_unique<fd_transport>(my_msr_fd);
+
+		//
+		// the caller keeps the descriptor when start fails
+		//
+
+		if(not my_link->configure(baud, low_latency)) {
+			int e = errno;
+			my_link->release();
+			errno = e;
+			return false;
+		}
+
+		return attach(std::move(my_link), my_oob_fd, my_msg_fd);
+	}
+
+	bool msr::start(std::unique_ptr<transport> my_link, int my_oob_fd, int my_msg_fd) {
 
-		msr_fd = open(device.c_str(), O_RDWR | O_NOCTTY);
-		if(msr_fd == -1)
-			goto failure;
+		if(active) {
+			errno = EALREADY;
+			return false;
+		}
 
-		tcgetattr(msr_fd, &options);
+		if(not my_link->configure(baud, low_latency))
+			return false;
 
-		if(cfsetispeed(&options, 0) == -1)
-			goto failure;
-		if(cfsetospeed(&options, B9600) == -1)
-			goto failure;
+		return attach(std::move(my_link), my_oob_fd, my_msg_fd);
+	}
 
-		options.c_cflag |= (CLOCAL | CREAD);
+	bool msr::attach(std::unique_ptr<transport> my_link, int my_oob_fd, int my_msg_fd) {
 
-		options.c_cflag &= ~PARENB;
-		options.c_cflag &= ~CSTOPB;
-		options.c_cflag &= ~CSIZE;
-		options.c_cflag |= CS8;
+		device.clear();
 
-		options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+		link = std::move(my_link);
 
-		options.c_cc[VMIN]  = 1;
-		options.c_cc[VTIME] = 0;
+		oob_fd = my_oob_fd;
 
-		options.c_oflag &= ~OPOST;
+		messages.stop();
+		messages.start(my_msg_fd);
 
-		if(tcsetattr(msr_fd, TCSANOW, &options) == -1)
-			goto failure;
+		io = io_stats{};
+
+		state = {};
+		resumed = 0;
+		retained = 0;
 
 		active = true;
 
 		return true;
-
-	failure:
-		if(msr_fd != -1) {
-			int e = errno;
-			close(msr_fd);
-			errno = e;
-		}
-		return false;
 	}
 
+	//
+	// waits for input from the device or the operator, sending any queued
+	// LED steps as they fall due so signalling never holds up a command
+	//
+
 	bool msr::sync() {
 
-		struct timeval tv = { sync_timeout, 0 };
+		if(resumed != io.reconnects and not resume())
+			return false;
+
+		if(retained > 0) {
+			msr_buffer.erase(0, retained);
+			retained = 0;
+		}
+
+		if(link->fd() == -1 and not (reconnect() and restore() and resume()))
+			return false;
+
+		auto deadline = clock_type::now() + std::chrono::seconds(sync_timeout);
 
 		int n;
 
 		fd_set rfds;
 
-		FD_ZERO(&rfds);
+		do {
+
+			pump();
+
+			auto until = deadline;
+
+			if(not leds.empty())
+				until = std::min(until, leds.front().due);
+
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(until - clock_type::now()).count();
+
+			struct timeval tv = { 0, 0 };
 
-		FD_SET(msr_fd, &rfds);
-		FD_SET(oob_fd, &rfds);
+			if(us > 0) {
+				tv.tv_sec = us / 1000000;
+				tv.tv_usec = us % 1000000;
+			}
+
+			FD_ZERO(&rfds);
+
+			FD_SET(link->fd(), &rfds);
+			FD_SET(oob_fd, &rfds);
 
-		n = select(std::max(msr_fd, oob_fd) + 1, &rfds, nullptr, nullptr, &tv);
-		if(n == -1)
-			return errno == EINTR;
+			n = select(std::max(link->fd(), oob_fd) + 1, &rfds, nullptr, nullptr, &tv);
+			if(n == -1)
+				return errno == EINTR;
+
+		} while(n == 0 and clock_type::now() < deadline);
 
 		if(n == 0) {
 			errno = ETIME;
 			return false;
 		}
 
-		if(FD_ISSET(msr_fd, &rfds))
-			if(not update(msr_fd, msr_buffer))
-				return false;
+		if(FD_ISSET(link->fd(), &rfds))
+			if(not update(link->fd(), msr_buffer))
+				return hungup(errno) and reconnect() and restore() and resume();
 
 		if(FD_ISSET(oob_fd, &rfds)) 
 			if(not update(oob_fd, oob_buffer))
@@ -165,26 +263,224 @@ namespace jank {
 		return true;
 	}
 
+	//
+	// in low-latency mode a wakeup keeps reading for as long as the next
+	// byte follows within two character times, so a reply arriving byte by
+	// byte is taken in one wakeup at the cost of two character times at its
+	// end (about 2ms at 9600 baud, well under the latency timer it replaces)
+	//
+
 	bool msr::update(int fd, buffer_type& buffer) {
 
 		char read_block[read_block_sz];
 
+		bool from_link = (link != nullptr and fd == link->fd());
+
+		long gather_us = from_link and low_latency ? 2 * 10 * 1000000L / baud : 0;
+
+		bool first = true;
+
 		ssize_t n;
 
-		n = ::read(fd, read_block, sizeof(read_block));
-		if(n == -1)
-			return errno == EINTR;
+		do {
+
+			n = from_link ? link->read(read_block, sizeof(read_block)) : ::read(fd, read_block, sizeof(read_block));
+			if(n == -1)
+				return errno == EINTR;
+
+			//
+			// a device that polls readable and then has nothing to give has
+			// hung up
+			//
+
+			if(n == 0 and from_link and first) {
+				errno = EPIPE;
+				return false;
+			}
+
+			first = false;
+
+			if(from_link) {
+				io.reads++;
+				io.bytes += n;
+			}
+
+			buffer.insert(buffer.end(), read_block, read_block + n);
+
+		} while(n > 0 and gather_us > 0 and readable(fd, gather_us));
+
+		if(from_link)
+			io.wakeups++;
+
+		return true;
+	}
+
+	bool msr::readable(int fd, long us) {
+
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+
+		return ppoll(&pfd, 1, &ts, nullptr) == 1;
+	}
+
+	void msr::consume(buffer_type::iterator iter) {
+		msr_buffer.erase(msr_buffer.begin(), iter);
+		io.responses++;
+	}
+
+	bool msr::hungup(int e) {
+		return e == EIO or e == ENXIO or e == ENODEV or e == EPIPE or e == ECONNRESET or e == ENOTCONN or e == EBADF;
+	}
+
+	bool msr::is_led(const void *buf, size_t sz) {
+		auto p = (const unsigned char *)buf;
+		return sz == 2 and p[0] == '\033' and p[1] >= (unsigned char)led::off and p[1] <= (unsigned char)led::red;
+	}
+
+	//
+	// after a hang-up the device is reopened by the same identity every
+	// reconnect_poll_ms until reconnect_ms runs out
+	//
+
+	bool msr::reconnect() const {
+
+		if(reconnect_ms <= 0 or restoring)
+			return false;
+
+		message("RECONNECT", logger::level::warn);
+
+		auto deadline = clock_type::now() + std::chrono::milliseconds(reconnect_ms);
+
+		do {
+
+			if(link->reopen()) {
+				io.reconnects++;
+				return true;
+			}
+
+			if(errno == ENOTSUP)
+				return false;
+
+			msleep(reconnect_poll_ms);
+
+		} while(clock_type::now() < deadline);
+
+		errno = ENODEV;
+
+		return false;
+	}
+
+	//
+	// a reconnected device is back in its power-on state; put back the
+	// coercivity and LED it had
+	//
+
+	bool msr::restore() const {
 
-		for(ssize_t i = 0; i < n; i++)
-			buffer.push_back(read_block[i]);
+		message("RESTORE", logger::level::warn);
+
+		restoring = true;
+
+		bool ok = reset();
+
+		if(ok and state.coercivity != 0) {
+			const char cmd[] = { '\033', state.coercivity };
+			ok = expect(cmd, sizeof(cmd), ESC "0", 2);
+		}
+
+		if(ok and state.led != 0) {
+			const char cmd[] = { '\033', state.led };
+			ok = writen(cmd, sizeof(cmd)) == sizeof(cmd);
+		}
+
+		restoring = false;
+
+		return ok;
+	}
+
+	//
+	// drops whatever arrived before the hang-up and sends the command in
+	// progress again if it went out on the old connection
+	//
+
+	bool msr::resume() {
+
+		msr_buffer.clear();
+		retained = 0;
+
+		resumed = io.reconnects;
+
+		if(state.generation != io.reconnects and state.command_length > 0) {
+			message("RESUME", logger::level::warn);
+			scope arena_scope(*this);
+			std::pmr::string cmd(state.command, state.command_length, &scratch);
+			if(writen(cmd.data(), cmd.length()) != (ssize_t)cmd.length())
+				return false;
+		}
 
 		return true;
 	}
 
-	void msr::message(const char *msg) const {
-		::write(msg_fd, "[", 1);
-		::write(msg_fd, msg, strlen(msg));
-		::write(msg_fd, "]\n", 2);
+	void msr::retain(buffer_type::iterator iter) {
+		retained = iter - msr_buffer.begin();
+		io.responses++;
+	}
+
+	//
+	// tries each rate in turn with a comm test and keeps the first one the
+	// device answers at, going back to the default rate if none does
+	//
+
+	long msr::probe(const std::vector<long>& rates) {
+
+		if(not active) {
+			errno = ENOMEDIUM;
+			return 0;
+		}
+
+		if(not link->serial()) {
+			errno = ENOTTY;
+			return 0;
+		}
+
+		long timeout = sync_timeout;
+
+		sync_timeout = 1;
+
+		for(long rate : rates) {
+
+			if(not link->configure(rate, low_latency))
+				continue;
+
+			baud = rate;
+
+			link->discard();
+			msr_buffer.clear();
+
+			std::vector<command> cmds = { { ESC "e", reply::ack, false, "" } };
+
+			if(exchange(cmds) and cmds[0].ok) {
+				sync_timeout = timeout;
+				return rate;
+			}
+		}
+
+		sync_timeout = timeout;
+
+		baud = default_baud;
+
+		link->configure(baud, low_latency);
+		link->discard();
+
+		msr_buffer.clear();
+
+		errno = ENODEV;
+
+		return 0;
+	}
+
+	void msr::message(const char *msg, logger::level l) const {
+		messages.post(l, msg);
 	}
 
 	bool msr::stop() {
@@ -196,19 +492,23 @@ namespace jank {
 
 		message("STOP");
 
-		if(cache.firmware) {
-			delete[] cache.firmware;
-			cache.firmware = nullptr;
-		}
+		//
+		// skip straight to the final LED state of anything still queued
+		//
 
-		if(cache.model) {
-			delete[] cache.model;
-			cache.model = nullptr;
+		if(not leds.empty()) {
+			char cmd[2] = { '\033', (char)leds.back().code };
+			leds.clear();
+			writen(cmd, sizeof(cmd));
 		}
 
-		close(msr_fd);
+		memset(&cache, 0, sizeof(cache));
+
+		link.reset();
 		active = false;
 
+		messages.stop();
+
 		return true;
 	}
 
@@ -217,10 +517,12 @@ namespace jank {
 		oob_buffer.clear();
 		msr_buffer.clear();
 
+		retained = 0;
+
 		if(tcflush(oob_fd, TCIFLUSH) == -1)
 			return false;
 
-		if(tcflush(msr_fd, TCIOFLUSH) == -1)
+		if(not link->discard())
 			return false;
 
 		return true;
@@ -251,12 +553,72 @@ namespace jank {
 		return writen(ESC "\x81", 2) == 2;
 	}
 
+	//
+	// queues an LED command to be sent ms after the previous queued one;
+	// the LED codes have no reply, so the steps are sent from sync() and
+	// idle() between and during real commands
+	//
+
+	void msr::signal(led code, int ms) const {
+		auto base = leds.empty() ? clock_type::now() : leds.back().due;
+		leds.push_back({ base + std::chrono::milliseconds(ms), code });
+	}
+
+	bool msr::pump() const {
+
+		auto now = clock_type::now();
+
+		while(not leds.empty() and leds.front().due <= now) {
+			char cmd[2] = { '\033', (char)leds.front().code };
+			leds.pop_front();
+			if(writen(cmd, sizeof(cmd)) != sizeof(cmd))
+				return false;
+		}
+
+		return true;
+	}
+
+	void msr::idle(int ms) const {
+
+		auto until = clock_type::now() + std::chrono::milliseconds(ms);
+
+		for(;;) {
+
+			pump();
+
+			auto next = leds.empty() ? until : std::min(until, leds.front().due);
+			auto us = std::chrono::duration_cast<std::chrono::microseconds>(next - clock_type::now()).count();
+
+			if(us > 0)
+				usleep(us);
+
+			if(clock_type::now() >= until)
+				break;
+		}
+
+		pump();
+	}
+
+	size_t msr::signals() const {
+		return leds.size();
+	}
+
+	void msr::clear_signals() const {
+		leds.clear();
+	}
+
 	bool msr::set_hico() {
-		return expect(ESC "x", 2, ESC "0", 2);
+		if(not expect(ESC "x", 2, ESC "0", 2))
+			return false;
+		state.coercivity = 'x';
+		return true;
 	}
 
 	bool msr::set_loco() {
-		return expect(ESC "y", 2, ESC "0", 2);
+		if(not expect(ESC "y", 2, ESC "0", 2))
+			return false;
+		state.coercivity = 'y';
+		return true;
 	}
 
 	bool msr::is_hico() {
@@ -294,6 +656,21 @@ namespace jank {
 			return false;
 	}
 
+	//
+	// swaps the descriptor whose newline cancels a wait, returning the one
+	// it replaces
+	//
+
+	int msr::interrupt(int fd) {
+
+		int prev = oob_fd;
+
+		oob_fd = fd;
+		oob_buffer.clear();
+
+		return prev;
+	}
+
 	bool msr::erase(bool t1, bool t2, bool t3) {
 
 		const char tracks = (t1 ? 1 : 0) | (t2 ? 2 : 0) | (t3 ? 4 : 0);
@@ -309,14 +686,14 @@ namespace jank {
 				auto resp = begins_with(msr_buffer, response::ok);
 
 				if(resp.first) {
-						msr_buffer.erase(msr_buffer.begin(), resp.second);
+						consume(resp.second);
 						return true;
 				}
 
 				resp = begins_with(msr_buffer, response::fail);
 
 				if(resp.first) {
-						msr_buffer.erase(msr_buffer.begin(), resp.second);
+						consume(resp.second);
 						errno = EIO;
 						return false;
 				}
@@ -347,31 +724,46 @@ namespace jank {
 
 	bool msr::write(const std::string& track1, const std::string& track2, const std::string& track3) {
 
+			scope arena_scope(*this);
+
 			message("WRITE");
 
-			std::string t1(track1);
-			std::string t2(track2);
-			std::string t3(track3);
+			std::pmr::string cmd(&scratch);
 
-			if(t1 == jank::track::empty) t1.clear();
-			if(t2 == jank::track::empty) t2.clear();
-			if(t3 == jank::track::empty) t3.clear();
+			cmd.append("\033w\033s");
 
-			if(not t1.empty() and t1.back() != '?') t1.push_back('?');
-			if(not t2.empty() and t2.back() != '?') t2.push_back('?');
-			if(not t3.empty() and t3.back() != '?') t3.push_back('?');
+			//
+			// an empty track marker writes nothing and every track ends in
+			// its end sentinel
+			//
 
-			std::stringstream ss;
+			auto put = [&cmd](char track_no, const std::string& data) {
+				cmd.push_back('\033');
+				cmd.push_back(track_no);
+				if(data == jank::track::empty or data.empty())
+					return;
+				cmd.append(data);
+				if(data.back() != '?')
+					cmd.push_back('?');
+			};
 
-			ss << "\033w\033s\033\1" << t1 << "\033\2" << t2 << "\033\3" << t3 << "\x3f\x1c";
+			put('\1', track1);
+			put('\2', track2);
+			put('\3', track3);
 
-			std::string cmd = ss.str();
+			cmd.append("\x3f\x1c");
 
-			std::stringstream msg;
-			msg << "DATA : " << hex(cmd);
-			message(msg.str().c_str());
+			if(messages.enabled(logger::level::trace)) {
 
-			if(writen(cmd.c_str(), cmd.length()) != (ssize_t)cmd.length())
+				size_t msg_sz = 8 + dump_size(cmd.length(), trace);
+				char *msg = (char *)scratch.allocate(msg_sz, 1);
+
+				memcpy(msg, "DATA : ", 7);
+				dump(msg + 7, msg_sz - 7, cmd.data(), cmd.length(), trace);
+				message(msg, logger::level::trace);
+			}
+
+			if(writen(cmd.data(), cmd.length()) != (ssize_t)cmd.length())
 					return false;
 
 			while(sync() and not cancel()) {
@@ -383,13 +775,15 @@ namespace jank {
 
 					char status = *std::prev(iter);
 
-					msr_buffer.erase(msr_buffer.begin(), iter);
+					consume(iter);
 
 					msr_errno = (int)(status - '0');
 
 					if(status == '0')
 						return true;
 
+					errno = EIO;
+
 					break;
 			}
 
@@ -405,64 +799,136 @@ namespace jank {
 			return false;
 
 	}
-	bool msr::rawrd(std::string& track1, std::string& track2, std::string& track3) {
-		std::smatch sm;
-		std::basic_string<unsigned char> data;
-		auto retval = rawrd(data);
-		std::string *tracks[] = { nullptr, &track1, &track2, &track3 };
+	//
+	// track views point into the receive buffer and stay valid until the
+	// next command; the reply is only dropped when the next one is awaited
+	//
+
+	bool msr::rawrd(std::array<view_type, 3>& tracks) {
 
-		unsigned int n = 0;
-		int seen = 0;
+		size_t length;
+
+		bool retval = receive('m', "RAWREAD", length);
+
+		auto data = retval ? view_type((const std::byte *)msr_buffer.data() + 2, length) : view_type();
 
 		for(int track_no = 1; track_no <= 3; track_no++) {
-			auto& track = *tracks[track_no];
-			int len;
-			if(data[n++] == '\033' and data[n++] == track_no && (len = data[n++]) > 0) {
-				seen++;
-				track = "";
-				while(len--)
-					track.push_back(data[n++]);
-			}
+
+			auto& track = tracks[track_no - 1];
+
+			track = view_type();
+
+			if(data.size() < 3 or data[0] != (std::byte)'\033' or data[1] != (std::byte)track_no)
+				break;
+
+			size_t len = std::min((size_t)data[2], data.size() - 3);
+
+			track = data.subspan(3, len);
+
+			data = data.subspan(3 + len);
 		}
 
-		std::cout << "SEEN := " << seen << std::endl;
+		return retval;
+	}
+
+	bool msr::read(std::array<view_type, 3>& tracks) {
+
+		static const view_type empty((const std::byte *)track::empty.data(), track::empty.length());
+
+		size_t length;
+
+		bool retval = receive('r', "READ", length);
+
+		tracks = { empty, empty, empty };
+
+		if(not retval)
+			return false;
+
+		std::string_view data(msr_buffer.data() + 2, length);
+
+		size_t t1 = data.starts_with("\033\001") ? 2 : std::string_view::npos;
+		size_t t2 = t1 == std::string_view::npos ? t1 : data.find("\033\002", t1);
+		size_t t3 = t2 == std::string_view::npos ? t2 : data.find("\033\003", t2 + 2);
+
+		if(t3 == std::string_view::npos)
+			return retval;
+
+		auto view = [&](size_t from, size_t to) {
+			return view_type((const std::byte *)data.data() + from, to - from);
+		};
+
+		tracks = { view(t1, t2), view(t2 + 2, t3), view(t3 + 2, data.length()) };
 
 		return retval;
 	}
 
-	bool msr::read(std::string& track1, std::string& track2, std::string& track3) {
-		std::cmatch cm;
-		std::string data;
-		auto retval = read(data);
+	bool msr::rawrd(std::string& track1, std::string& track2, std::string& track3) {
 
-		track1 = jank::track::empty;
-		track2 = jank::track::empty;
-		track3 = jank::track::empty;
+		std::array<view_type, 3> views;
 
-		//std::cout << "RETURN=" << (retval ? "TRUE" : "FALSE") << " DATA=" << hex(data) << std::endl;
+		auto retval = rawrd(views);
 
-		std::regex e("^\\x1b\\x01(.*)\\x1b\\x02(.*)\\x1b\\x03(.*)");
+		std::string *tracks[] = { &track1, &track2, &track3 };
 
-		std::regex_match(data.c_str(), cm, e);
+		for(int n = 0; n < 3; n++)
+			if(not views[n].empty())
+				tracks[n]->assign((const char *)views[n].data(), views[n].size());
 
-		//std::cout << "REGEX_MATCH := ( CM.SIZE() = " << cm.size() << " )" << std::endl;
+		return retval;
+	}
 
-		//for(size_t n = 0; n < cm.size(); n++)
-		// std::cout << "MATCH " << n << "(" << cm.length(n) << ")" << " := " << hex(cm.str(n)) << std::endl;
+	bool msr::read(std::string& track1, std::string& track2, std::string& track3) {
 
-		if(cm.size() == 4) {
-			track1 = std::string(cm.str(1).c_str(), cm.length(1));
-			track2 = std::string(cm.str(2).c_str(), cm.length(2));
-			track3 = std::string(cm.str(3).c_str(), cm.length(3));
-		}
+		std::array<view_type, 3> views;
+
+		auto retval = read(views);
+
+		track1.assign((const char *)views[0].data(), views[0].size());
+		track2.assign((const char *)views[1].data(), views[1].size());
+		track3.assign((const char *)views[2].data(), views[2].size());
 
 		return retval;
 	}
+
 	bool msr::rawrd(std::basic_string<unsigned char>& data) {
 
-		const char cmd[] = { '\033', 'm' };
+		size_t length;
+
+		bool retval = receive('m', "RAWREAD", length);
+
+		if(retval)
+			data.append((const unsigned char *)msr_buffer.data() + 2, length);
+
+		return retval;
+	}
+
+	bool msr::read(std::string& data) {
+
+		size_t length;
+
+		if(not receive('r', "READ", length))
+			return false;
+
+		data.append(msr_buffer, 2, length);
+
+		return true;
+	}
+
+	//
+	// sends a read command and waits for its ESC s ... ? FS ESC status
+	// frame; on success the frame is left at the front of the buffer with
+	// length data bytes after the ESC s, until the next sync drops it. A
+	// failed status leaves msr_errno set and errno EIO, so it is told
+	// apart from an empty card (success, no data) and a lost device
+	//
 
-		message("RAWREAD");
+	bool msr::receive(char op, const char *msg, size_t& length) {
+
+		const char cmd[] = { '\033', op };
+
+		message(msg);
+
+		msr_errno = 0;
 
 		if(writen(cmd, sizeof(cmd)) != sizeof(cmd))
 			return false;
@@ -474,6 +940,7 @@ namespace jank {
 			compare_position(iter, msr_buffer, isescape);
 			compare_position(iter, msr_buffer, is('s'));
 
+			auto data_begin = iter;
 			auto data_end = iter;
 
 			for(; data_end != msr_buffer.end(); data_end++) {
@@ -488,8 +955,7 @@ namespace jank {
 			if(data_end == msr_buffer.end())
 				continue;
 
-			while(iter != data_end)
-				data.push_back(*iter++);
+			iter = data_end;
 
 			compare_position(iter, msr_buffer, is('?'));
 			compare_position(iter, msr_buffer, is('\34'));
@@ -498,13 +964,17 @@ namespace jank {
 
 			char status = *std::prev(iter);
 
-			msr_buffer.erase(msr_buffer.begin(), iter);
+			length = data_end - data_begin;
+
+			retain(iter);
 
 			msr_errno = (int)(status - '0');
 
 			if(status == '0')
 				return true;
 
+			errno = EIO;
+
 			break;
 		}
 
@@ -520,57 +990,172 @@ namespace jank {
 		return false;
 	}
 
+	//
+	// every known model reads track 2, so an unknown one is assumed to
+	// read only that
+	//
 
-	bool msr::read(std::string& data) {
+	bool msr::has_track1() {
+		const model::profile *p = model::lookup(model());
+		return p != nullptr and (p->tracks & 1);
+	}
 
-		const char cmd[] = { '\033', 'r' };
+	bool msr::has_track2() {
+		const model::profile *p = model::lookup(model());
+		return p == nullptr or (p->tracks & 2);
+	}
 
-		message("READ");
+	bool msr::has_track3() {
+		const model::profile *p = model::lookup(model());
+		return p != nullptr and (p->tracks & 4);
+	}
 
-		if(writen(cmd, sizeof(cmd)) != sizeof(cmd))
-			return false;
+	void msr::reserve(size_t n) {
+		msr_buffer.reserve(n);
+	}
 
-		while(sync() and not cancel()) {
+	//
+	// parses one reply of the given kind at the front of the buffer:
+	// 1 when complete (iter moved past it), 0 when more bytes are needed
+	// and -1 when the bytes cannot be that reply
+	//
 
-			auto iter = msr_buffer.begin();
+	int msr::parse(reply rx, buffer_type::iterator& iter, std::string& value, bool& ok) const {
 
-			compare_position(iter, msr_buffer, isescape);
-			compare_position(iter, msr_buffer, is('s'));
+		auto end = msr_buffer.end();
 
-			auto data_end = iter;
+		auto want = [&](auto pred, bool keep) {
+			if(iter == end)
+				return 0;
+			if(not pred(*iter))
+				return -1;
+			if(keep)
+				value.push_back(*iter);
+			iter++;
+			return 1;
+		};
 
-			for(; data_end != msr_buffer.end(); data_end++) {
-				auto jter = data_end;
-				compare_position_nf(jter, msr_buffer, is('?'));
-				compare_position_nf(jter, msr_buffer, is('\034'));
-				compare_position_nf(jter, msr_buffer, isescape);
-				compare_position_nf(jter, msr_buffer, isstatus);
-				break;
-			}
+		auto chr = [](char c) { return [c](char x) { return x == c; }; };
 
-			if(data_end == msr_buffer.end())
-				continue;
+		value.clear();
+		ok = false;
 
-			while(iter != data_end)
-				data.push_back(*iter++);
+		int r;
 
-			compare_position(iter, msr_buffer, is('?'));
-			compare_position(iter, msr_buffer, is('\34'));
-			compare_position(iter, msr_buffer, isescape);
-			compare_position(iter, msr_buffer, isstatus);
+		if((r = want(chr('\033'), false)) != 1)
+			return r;
 
-			char status = *std::prev(iter);
+		switch(rx) {
 
-			msr_buffer.erase(msr_buffer.begin(), iter);
+			case reply::none:
+				return -1;
 
-			msr_errno = (int)(status - '0');
+			case reply::status:
+				if((r = want([](char x) { return x == '0' or x == 'A'; }, true)) != 1)
+					return r;
+				ok = (value == "0");
+				return 1;
+
+			case reply::ack:
+				if((r = want(chr('y'), true)) != 1)
+					return r;
+				ok = true;
+				return 1;
+
+			case reply::coercivity:
+				if((r = want([](char x) { return x == 'h' or x == 'l'; }, true)) != 1)
+					return r;
+				ok = true;
+				return 1;
+
+			case reply::model:
+				if((r = want([](char x) { return isdigit(x); }, true)) != 1)
+					return r;
+				if((r = want(chr('S'), false)) != 1)
+					return r;
+				ok = true;
+				return 1;
+
+			case reply::firmware:
+				for(auto pred : std::initializer_list<bool (*)(char)> {
+					[](char x) { return x == 'R'; },
+					[](char x) { return x == 'E'; },
+					[](char x) { return x == 'V'; },
+					[](char x) { return isalpha(x) != 0; },
+					[](char x) { return isdigit(x) != 0; },
+					[](char x) { return x == '.'; },
+					[](char x) { return isdigit(x) != 0; },
+					[](char x) { return isdigit(x) != 0; } })
+				{
+					if((r = want(pred, true)) != 1)
+						return r;
+				}
+				ok = true;
+				return 1;
+		}
 
-			if(status == '0')
-				return true;
+		return -1;
+	}
 
-			break;
+	//
+	// sends every command in one write and then matches the replies, which
+	// the device returns in command order, back to their commands
+	//
+
+	bool msr::exchange(std::vector<command>& cmds) {
+
+		scope arena_scope(*this);
+
+		std::pmr::string tx(&scratch);
+
+		message("EXCHANGE");
+
+		for(auto& c : cmds) {
+			tx.append(c.tx);
+			c.ok = (c.rx == reply::none);
+			c.value.clear();
+		}
+
+		if(writen(tx.data(), tx.length()) != (ssize_t)tx.length())
+			return false;
+
+		size_t k = 0;
+
+		auto skip = [&] {
+			while(k < cmds.size() and cmds[k].rx == reply::none)
+				k++;
+		};
+
+		skip();
+
+		while(k < cmds.size() and sync() and not cancel()) {
+
+			int r = 1;
+
+			while(k < cmds.size()) {
+
+				auto iter = msr_buffer.begin();
+
+				r = parse(cmds[k].rx, iter, cmds[k].value, cmds[k].ok);
+				if(r != 1)
+					break;
+
+				consume(iter);
+
+				k++;
+
+				skip();
+			}
+
+			if(r == -1) {
+				errno = EPROTO;
+				break;
+			}
 		}
 
+		if(k == cmds.size())
+			return true;
+
 		int e = errno;
 
 		msleep(250);
@@ -583,19 +1168,36 @@ namespace jank {
 		return false;
 	}
 
-	bool msr::has_track1() {
-		char m = model();
-		return m == '3' or m == '5';
-	}
+	//
+	// session start-up in one round trip: reset, coercivity, comm test,
+	// model and firmware, caching the model and firmware
+	//
 
-	bool msr::has_track2() {
-		char m = model();
-		return m != -1;
-	}
+	bool msr::setup(bool hico) {
 
-	bool msr::has_track3() {
-		char m = model();
-		return m == '2' or m == '3';
+		std::vector<command> cmds = {
+			{ ESC "a", reply::none, false, "" },
+			{ hico ? ESC "x" : ESC "y", reply::status, false, "" },
+			{ ESC "e", reply::ack, false, "" },
+			{ ESC "t", reply::model, false, "" },
+			{ ESC "v", reply::firmware, false, "" },
+		};
+
+		message("SETUP");
+
+		if(not exchange(cmds))
+			return false;
+
+		if(cache.model == '\0')
+			cache.model = cmds[3].value[0];
+
+		if(cache.firmware[0] == '\0')
+			strncpy(cache.firmware, cmds[4].value.c_str(), sizeof(cache.firmware) - 1);
+
+		if(cmds[1].ok)
+			state.coercivity = hico ? 'x' : 'y';
+
+		return cmds[1].ok and cmds[2].ok;
 	}
 
 	char msr::model() {
@@ -604,8 +1206,8 @@ namespace jank {
 
 			message("MODEL");
 
-			if(cache.model != nullptr)
-					return *cache.model;
+			if(cache.model != '\0')
+					return cache.model;
 
 			if(writen(cmd, sizeof(cmd)) != sizeof(cmd))
 					return '\0';
@@ -614,19 +1216,24 @@ namespace jank {
 
 					auto iter = msr_buffer.begin();
 
-					char ch;
+					std::string s;
+					bool ok;
+
+					int r = parse(reply::model, iter, s, ok);
 
-					if(iter == msr_buffer.end()) continue; if(*iter != '\033') { errno = EPROTO; break; } else iter++;
-					if(iter == msr_buffer.end()) continue; if(not isdigit(*iter)) { errno = EPROTO; break; } else ch = *iter++;
-					if(iter == msr_buffer.end()) continue; if(*iter != 'S') { errno = EPROTO; break; } else iter++;
+					if(r == 0)
+						continue;
 
-					msr_buffer.erase(msr_buffer.begin(), iter);
+					if(r == -1) {
+						errno = EPROTO;
+						break;
+					}
 
-					cache.model = new char;
+					consume(iter);
 
-					*cache.model = ch;
+					cache.model = s[0];
 
-					return *cache.model;
+					return cache.model;
 			}
 
 			int e = errno;
@@ -647,7 +1254,7 @@ namespace jank {
 
 			message("FIRMWARE");
 
-			if(cache.firmware != nullptr)
+			if(cache.firmware[0] != '\0')
 					return cache.firmware;
 
 			if(writen(cmd, sizeof(cmd)) != sizeof(cmd))
@@ -658,22 +1265,21 @@ namespace jank {
 					auto iter = msr_buffer.begin();
 
 					std::string s;
+					bool ok;
 
-					if(iter == msr_buffer.end()) continue; if(*iter != '\033') { errno = EPROTO; break; } else iter++;
-					if(iter == msr_buffer.end()) continue; if(*iter != 'R') { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(*iter != 'E') { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(*iter != 'V') { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(not isalpha(*iter)) { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(not isdigit(*iter)) { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(*iter != '.') { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(not isdigit(*iter)) { errno = EPROTO; break; } else s.push_back(*iter++);
-					if(iter == msr_buffer.end()) continue; if(not isdigit(*iter)) { errno = EPROTO; break; } else s.push_back(*iter++);
+					int r = parse(reply::firmware, iter, s, ok);
 
-					msr_buffer.erase(msr_buffer.begin(), iter);
+					if(r == 0)
+						continue;
 
-					cache.firmware = new char[s.length() + 1];
+					if(r == -1) {
+						errno = EPROTO;
+						break;
+					}
 
-					strcpy(cache.firmware, s.c_str());
+					consume(iter);
+
+					strncpy(cache.firmware, s.c_str(), sizeof(cache.firmware) - 1);
 
 					return cache.firmware;
 			}
@@ -690,29 +1296,35 @@ namespace jank {
 
 	bool msr::expect(const void *tx, size_t tx_sz, const void *rx, size_t rx_sz) const {
 
-		char *buf;
+		scope arena_scope(*this);
 
 		ssize_t n;
 
-		if(writen(tx, tx_sz) != (ssize_t)tx_sz)
-			return false;
+		char *buf = (char *)scratch.allocate(rx_sz, 1);
 
-		buf = new char[rx_sz];
+		//
+		// a hang-up while waiting for the reply reconnects and asks again
+		//
 
-		n = readn(buf, rx_sz);
+		for(int attempt = 0; ; attempt++) {
 
-		if(n == -1) {
-			delete[] buf;
-			return false;
-		}
+			if(writen(tx, tx_sz) != (ssize_t)tx_sz)
+				return false;
 
-		// std::cout << "EXPECT RESPONSE : " << hex(buf, n) << std::endl;
+			n = readn(buf, rx_sz);
 
-		bool X = memncmp(buf, n, rx, rx_sz) == 0;
+			if(n != -1)
+				break;
+
+			if(attempt > 0 or not (hungup(errno) and reconnect() and restore()))
+				return false;
+		}
+
+		io.responses++;
 
-		delete[] buf;
+		// std::cout << "EXPECT RESPONSE : " << hex(buf, n) << std::endl;
 
-		return X;
+		return memncmp(buf, n, rx, rx_sz) == 0;
 	}
 
 	int msr::memncmp(const void *s1, size_t s1_sz, const void *s2, size_t s2_sz) const {
@@ -737,11 +1349,16 @@ namespace jank {
 
 		while(left > 0) {
 
-			n = ::write(msr_fd, p + done, left);
+			n = link->write(p + done, left);
 
 			if(n == -1) {
 				if(errno == EINTR)
 					continue;
+				if(hungup(errno) and reconnect() and restore()) {
+					left = sz;
+					done = 0;
+					continue;
+				}
 				return -1;
 			}
 
@@ -749,6 +1366,18 @@ namespace jank {
 			done += n;
 		}
 
+		//
+		// writes made while restoring are not part of the session state
+		//
+
+		if(not restoring and is_led(buf, sz)) {
+			state.led = p[1];
+		} else if(not restoring) {
+			state.command_length = sz <= command_max ? sz : 0;
+			memcpy(state.command, p, state.command_length);
+			state.generation = io.reconnects;
+		}
+
 		return done;
 	}
 
@@ -765,16 +1394,46 @@ namespace jank {
 			return -1;
 		}
 
+		//
+		// a stalled device gets as long as sync() would give it, and a
+		// read of nothing after poll said there was something is the
+		// peer going away, whichever of POLLIN or POLLHUP it raised
+		//
+
 		while(left > 0) {
 
-			n = ::read(msr_fd, p + done, left);
+			pollfd pfd = { link->fd(), POLLIN, 0 };
 
-			if(n == -1) {
+			int r = poll(&pfd, 1, sync_timeout * 1000);
+
+			if(r == -1) {
 				if(errno == EINTR)
 					continue;
 				return -1;
 			}
 
+			if(r == 0) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+
+			n = link->read(p + done, left);
+
+			if(n == -1) {
+				if(errno == EINTR or errno == EAGAIN)
+					continue;
+				return -1;
+			}
+
+			if(n == 0) {
+				errno = EPIPE;
+				return -1;
+			}
+
+			io.reads++;
+			io.wakeups++;
+			io.bytes += n;
+
 			left -= n;
 			done += n;
 		}
@@ -788,37 +1447,10 @@ namespace jank {
 
 	std::string msr::hex(const char *s, size_t sz) const {
 
-		const std::string underline = "\033[4m";
-		const std::string bold = "\033[1m";
-		const std::string reset = "\033[0m";
-
-		std::stringstream ss;
-
-		ss << "char s[" << std::dec << sz << "] = { ";
-
-		for(unsigned int n = 0; n < sz; n++) {
-			unsigned char c = (unsigned char)s[n];
-			if(false) {
-				// NOP
-			} else if(c == '\034') {
-				ss << bold << "[FS]" << reset;
-			} else if(c >= 0 and c <= 27) {
-				ss << bold << '^' << (char)(c + '@') << reset;
-			} else if(c == '\0') {
-				ss << bold << "[NUL]" << reset;
-			} else if(c == '\033') {
-				ss << bold << "[ESC]" << reset;
-			} else if(ispunct(c)) {
-				ss << c;
-			} else if(isalnum(c)) {
-				ss << c;
-			} else {
-				ss << bold << std::hex << std::setfill('0') << std::setw(2) << (int)c << reset;
-			}
-		}
+		std::string out(dump_size(sz, trace), '\0');
 
-		ss << " };";
+		out.resize(dump(out.data(), out.length() + 1, s, sz, trace));
 
-		return ss.str();
+		return out;
 	}
 }
@@ -1,11 +1,21 @@
 #pragma once
 
 #include <string>
-#include <list>
+#include <span>
+#include <cstddef>
+#include <deque>
+#include <vector>
 #include <array>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
 
 #include <unistd.h>
 
+#include <transport.hh>
+#include <format.hh>
+#include <logger.hh>
+
 #define msleep(X) usleep((X) * 1000)
 
 namespace jank {
@@ -29,13 +39,81 @@ namespace jank {
 			static bool is_ok(const std::string&);
 	};
 
+	//
+	// forwards to another resource and counts what it hands out; msr keeps
+	// one under its arena, so a count that moves means a command outgrew it
+	//
+
+	class counted_resource : public std::pmr::memory_resource {
+
+		public:
+
+			unsigned long allocations;
+			unsigned long bytes;
+
+			std::pmr::memory_resource *upstream;
+
+			counted_resource(std::pmr::memory_resource *);
+
+		private:
+
+			void *do_allocate(size_t, size_t) override;
+			void do_deallocate(void *, size_t, size_t) override;
+			bool do_is_equal(const std::pmr::memory_resource&) const noexcept override;
+	};
+
 	class msr {
 
 		public:
 
 			static std::string msr_strerror(int errnum);
 
-			using buffer_type = std::list<char>;
+			using buffer_type = std::string;
+
+			using view_type = std::span<const std::byte>;
+
+			using clock_type = std::chrono::steady_clock;
+
+			enum class reply : unsigned char { none, status, ack, coercivity, model, firmware };
+
+			struct command {
+				std::string tx;
+				reply rx;
+				bool ok;
+				std::string value;
+			};
+
+			enum class led : char { off = '\x81', on = '\x82', green = '\x83', yellow = '\x84', red = '\x85' };
+
+			//
+			// device reads per reply, for comparing transport settings
+			//
+
+			struct io_stats {
+				unsigned long wakeups;
+				unsigned long reads;
+				unsigned long bytes;
+				unsigned long responses;
+				unsigned long reconnects;
+				double per_response() const;
+			};
+
+			//
+			// commands run on the arena and how often one spilled past it
+			// into the upstream resource
+			//
+
+			struct arena_stats {
+				unsigned long commands;
+				unsigned long spills;
+				unsigned long spill_bytes;
+			};
+
+			constexpr static size_t arena_size = 16384;
+
+			constexpr static long default_baud = 9600;
+
+			constexpr static long reconnect_poll_ms = 50;
 
 			bool active;
 
@@ -45,7 +123,20 @@ namespace jank {
 			
 			int msr_errno;
 
+			long baud;
+			bool low_latency;
+
+			long reconnect_ms;
+
+			mutable io_stats io;
+
+			dump_style trace;
+
+			mutable logger messages;
+
 			bool start(const char *, int, int);
+			bool start(int, int, int);
+			bool start(std::unique_ptr<transport>, int, int);
 			bool stop();
 
 			bool sync();
@@ -59,16 +150,30 @@ namespace jank {
 			bool green() const;
 			bool on() const;
 			bool off() const;
+
+			void signal(led, int) const;
+			bool pump() const;
+			void idle(int) const;
+			size_t signals() const;
+			void clear_signals() const;
 			bool erase(bool,bool,bool);
 			bool erase();
 
 			bool read(std::string&, std::string&, std::string&);
 			bool read(std::string&);
+			bool read(std::array<view_type, 3>&);
 			bool rawrd(std::string&, std::string&, std::string&);
 			bool rawrd(std::basic_string<unsigned char>&);
+			bool rawrd(std::array<view_type, 3>&);
 			bool write(const std::string&, const std::string&, const std::string&);
 
 			bool cancel();
+			int interrupt(int);
+
+			bool exchange(std::vector<command>&);
+			bool setup(bool);
+
+			long probe(const std::vector<long>&);
 
 			bool test_comm() const;
 			bool test_ram() const;
@@ -78,6 +183,8 @@ namespace jank {
 			bool has_track2();
 			bool has_track3();
 
+			void reserve(size_t);
+
 			bool set_hico();
 			bool set_loco();
 
@@ -87,29 +194,99 @@ namespace jank {
 			char model();
 			const char *firmware();
 
-			msr();
+			arena_stats arena() const;
+
+			msr(std::pmr::memory_resource * = std::pmr::new_delete_resource());
 			~msr();
 
 		private:
 
 			struct {
-				char *model;
-				char *firmware;
+				char model;
+				char firmware[32];
 			} cache;
 
-			int msr_fd;
+			//
+			// per-command temporaries come from a monotonic arena over a
+			// block taken once from the upstream resource, released when
+			// the outermost command returns; a reconnect can run commands
+			// inside another, hence the depth
+			//
+
+			mutable counted_resource spill;
+
+			std::byte *arena_block;
+
+			mutable std::pmr::monotonic_buffer_resource scratch;
+
+			mutable int arena_depth;
+			mutable unsigned long arena_commands;
+
+			struct scope {
+				const msr& owner;
+				scope(const msr&);
+				~scope();
+			};
+
+			std::unique_ptr<transport> link;
 			int oob_fd;
-			int msg_fd;
 
 			buffer_type msr_buffer;
 			buffer_type oob_buffer;
 
-			constexpr static size_t read_block_sz = 1024;
+			struct led_step {
+				clock_type::time_point due;
+				led code;
+			};
+
+			mutable std::deque<led_step> leds;
+
+			constexpr static size_t read_block_sz = 4096;
 
-			void message(const char *) const;
+			static bool readable(int, long);
+
+			//
+			// what a reconnect has to put back; the last command is kept in
+			// place so recording it never allocates, and one too long to
+			// keep is simply not resent
+			//
+
+			constexpr static size_t command_max = 1024;
+
+			mutable struct {
+				char coercivity;
+				char led;
+				size_t command_length;
+				char command[command_max];
+				unsigned long generation;
+			} state;
+
+			mutable bool restoring;
+
+			unsigned long resumed;
+
+			size_t retained;
+
+			static bool hungup(int);
+			static bool is_led(const void *, size_t);
+
+			bool reconnect() const;
+			bool restore() const;
+			bool resume();
+
+			void consume(buffer_type::iterator);
+			void retain(buffer_type::iterator);
+
+			bool receive(char, const char *, size_t&);
+
+			void message(const char *, logger::level = logger::level::info) const;
+
+			bool attach(std::unique_ptr<transport>, int, int);
 
 			bool expect(const void *, size_t, const void *, size_t) const;
 
+			int parse(reply, buffer_type::iterator&, std::string&, bool&) const;
+
 			ssize_t writen(const void *, size_t) const;
 			ssize_t readn(void *, size_t) const;
 			int memncmp(const void *, size_t, const void *, size_t) const;
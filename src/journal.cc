@@ -0,0 +1,193 @@
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <journal.hh>
+
+namespace jank {
+
+	static const char journal_magic[8] = { 'J', 'A', 'N', 'K', 'J', 'N', 'L', '1' };
+
+	journal::journal() : commit_every(default_commit_every), commits(0), fd(-1), uncommitted(0), last(0), last_offset(0), begun(0), begun_offset(0), failures(0) {
+	}
+
+	journal::~journal() {
+		close();
+	}
+
+	bool journal::open(const char *path) {
+
+		if(fd != -1) {
+			errno = EALREADY;
+			return false;
+		}
+
+		fd = ::open(path, O_RDWR | O_CREAT, 0644);
+
+		return fd != -1;
+	}
+
+	bool journal::close() {
+
+		if(fd == -1)
+			return false;
+
+		bool success = commit();
+
+		::close(fd);
+
+		fd = -1;
+
+		return success;
+	}
+
+	void journal::replay(const entry& e) {
+		switch(e.what) {
+			case begin:
+				begun = e.n;
+				begun_offset = e.offset;
+				break;
+			case abandoned:
+				if(begun == (int)e.n)
+					begun = 0;
+				break;
+			case failed:
+				failures++;
+				[[fallthrough]];
+			case done:
+				last = e.n;
+				last_offset = e.offset;
+				break;
+		}
+	}
+
+	//
+	// binds the journal to an input file and workflow; a journal written
+	// for anything else is discarded and restarted
+	//
+
+	bool journal::attach(int input, uint32_t workflow) {
+
+		struct stat sb;
+		header h, mine;
+		entry e;
+
+		if(fd == -1) {
+			errno = EBADF;
+			return false;
+		}
+
+		if(fstat(input, &sb) == -1)
+			return false;
+
+		memset(&mine, 0, sizeof(mine));
+		memcpy(mine.magic, journal_magic, sizeof(journal_magic));
+		mine.workflow = workflow;
+
+		//
+		// a stream has no identity beyond the workflow reading it
+		//
+
+		if(S_ISREG(sb.st_mode)) {
+			mine.size = sb.st_size;
+			mine.mtime = (int64_t)sb.st_mtim.tv_sec * 1000000000 + sb.st_mtim.tv_nsec;
+		}
+
+		last = 0;
+		last_offset = 0;
+		begun = 0;
+		begun_offset = 0;
+		failures = 0;
+		uncommitted = 0;
+
+		if(pread(fd, &h, sizeof(h), 0) == sizeof(h) and memcmp(&h, &mine, sizeof(h)) == 0) {
+
+			off_t at = sizeof(h);
+
+			while(pread(fd, &e, sizeof(e), at) == sizeof(e)) {
+				replay(e);
+				at += sizeof(e);
+			}
+
+			//
+			// drop a torn trailing entry so appends stay aligned
+			//
+
+			if(ftruncate(fd, at) == -1 or lseek(fd, at, SEEK_SET) == -1)
+				return false;
+
+			return true;
+		}
+
+		if(ftruncate(fd, 0) == -1 or lseek(fd, 0, SEEK_SET) == -1)
+			return false;
+
+		if(::write(fd, &mine, sizeof(mine)) != sizeof(mine))
+			return false;
+
+		return commit();
+	}
+
+	bool journal::mark(kind what, int n, uint64_t offset) {
+
+		entry e = { what, (uint32_t)n, offset };
+
+		if(fd == -1) {
+			errno = EBADF;
+			return false;
+		}
+
+		if(::write(fd, &e, sizeof(e)) != sizeof(e))
+			return false;
+
+		replay(e);
+
+		//
+		// a begin is on disk before the card is written, so a crash can
+		// never leave a written card that the journal knows nothing about
+		//
+
+		if(++uncommitted >= commit_every or what == begin)
+			return commit();
+
+		return true;
+	}
+
+	bool journal::commit() {
+
+		if(fd == -1 or uncommitted == 0)
+			return fd != -1;
+
+		if(fdatasync(fd) == -1)
+			return false;
+
+		uncommitted = 0;
+		commits++;
+
+		return true;
+	}
+
+	int journal::next() const {
+		return last + 1;
+	}
+
+	uint64_t journal::offset() const {
+		return last_offset;
+	}
+
+	int journal::pending() const {
+		return begun > last ? begun : 0;
+	}
+
+	uint64_t journal::pending_offset() const {
+		return begun_offset;
+	}
+
+	int journal::skipped() const {
+		return failures;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace jank {
+
+	//
+	// append-only progress journal for batch writes; entries are written
+	// as each record finishes and fsync'd in groups, a begin is fsync'd
+	// before its card is written, and replaying the journal gives the
+	// first unfinished record and its file offset; a record cancelled
+	// before anything reached its card is closed as abandoned, which
+	// leaves it unfinished rather than pending
+	//
+
+	class journal {
+
+		public:
+
+			enum kind : uint32_t { begin = 1, done = 2, failed = 3, abandoned = 4 };
+
+			struct header {
+				char magic[8];
+				uint64_t size;
+				int64_t mtime;
+				uint32_t workflow;
+				uint32_t reserved;
+			};
+
+			struct entry {
+				uint32_t what;
+				uint32_t n;
+				uint64_t offset;
+			};
+
+			constexpr static unsigned int default_commit_every = 16;
+
+			unsigned int commit_every;
+
+			unsigned long commits;
+
+			bool open(const char *);
+			bool close();
+
+			bool attach(int, uint32_t);
+
+			bool mark(kind, int, uint64_t);
+			bool commit();
+
+			int next() const;
+			uint64_t offset() const;
+			int pending() const;
+			uint64_t pending_offset() const;
+			int skipped() const;
+
+			journal();
+			~journal();
+
+		private:
+
+			int fd;
+
+			unsigned int uncommitted;
+
+			int last;
+			uint64_t last_offset;
+			int begun;
+			uint64_t begun_offset;
+			int failures;
+
+			void replay(const entry&);
+	};
+
+}
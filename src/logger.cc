@@ -0,0 +1,182 @@
+#include <algorithm>
+
+#include <cstring>
+#include <strings.h>
+#include <cerrno>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <logger.hh>
+
+namespace jank {
+
+	logger::logger() : threshold(level::trace), posted(0), dropped(0), writes(0), fd(-1), head(0), tail(0), wake(0), waiting(false), running(false) {
+	}
+
+	logger::~logger() {
+		stop();
+	}
+
+	bool logger::start(int my_fd) {
+
+		if(running) {
+			errno = EALREADY;
+			return false;
+		}
+
+		if(ring == nullptr)
+			ring = std::make_unique<char[]>(ring_size);
+
+		fd = my_fd;
+		head = 0;
+		tail = 0;
+		running = true;
+
+		drainer = std::thread([this] { drain(); });
+
+		return true;
+	}
+
+	//
+	// writes out what is still queued before the thread exits
+	//
+
+	bool logger::stop() {
+
+		if(not running)
+			return false;
+
+		running = false;
+
+		wake.fetch_add(1);
+		wake.notify_one();
+
+		drainer.join();
+
+		return true;
+	}
+
+	static const char *level_names[] = { "off", "error", "warn", "info", "debug", "trace" };
+
+	bool logger::parse(const char *s, level& l) {
+		for(size_t n = 0; n < sizeof(level_names) / sizeof(*level_names); n++) {
+			if(strcasecmp(s, level_names[n]) == 0) {
+				l = (level)n;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const char *logger::name(level l) {
+		return (size_t)l < sizeof(level_names) / sizeof(*level_names) ? level_names[(size_t)l] : "unknown";
+	}
+
+	bool logger::post(level l, const char *msg) {
+		return post(l, msg, strlen(msg));
+	}
+
+	//
+	// the line goes out as [msg]\n; without the thread it is written here
+	//
+
+	bool logger::post(level l, const char *msg, size_t sz) {
+
+		if(not enabled(l))
+			return false;
+
+		if(not running) {
+
+			if(fd == -1)
+				return false;
+
+			iovec iov[3] = { { (void *)"[", 1 }, { (void *)msg, sz }, { (void *)"]\n", 2 } };
+
+			writes++;
+
+			return writev(fd, iov, 3) != -1;
+		}
+
+		size_t n = sz + 3;
+
+		uint64_t h = head.load(std::memory_order_relaxed);
+		uint64_t t = tail.load(std::memory_order_acquire);
+
+		if(n > ring_size - (h - t)) {
+			dropped++;
+			return false;
+		}
+
+		put(h, "[", 1);
+		put(h + 1, msg, sz);
+		put(h + 1 + sz, "]\n", 2);
+
+		head.store(h + n);
+
+		posted++;
+
+		if(waiting.load()) {
+			wake.fetch_add(1);
+			wake.notify_one();
+		}
+
+		return true;
+	}
+
+	void logger::put(uint64_t pos, const char *p, size_t sz) {
+
+		size_t at = pos % ring_size;
+		size_t first = std::min(sz, ring_size - at);
+
+		memcpy(ring.get() + at, p, first);
+		memcpy(ring.get(), p + first, sz - first);
+	}
+
+	//
+	// the waiting flag is raised before head is checked, so a post either
+	// shows up in that check or sees the flag and bumps wake
+	//
+
+	void logger::drain() {
+
+		for(;;) {
+
+			uint32_t w = wake.load();
+
+			waiting.store(true);
+
+			uint64_t t = tail.load(std::memory_order_relaxed);
+			uint64_t h = head.load();
+
+			if(h == t) {
+				if(not running.load()) {
+					waiting.store(false);
+					break;
+				}
+				wake.wait(w);
+				continue;
+			}
+
+			waiting.store(false);
+
+			size_t at = t % ring_size;
+			size_t sz = h - t;
+			size_t first = std::min(sz, ring_size - at);
+
+			iovec iov[2] = { { ring.get() + at, first }, { ring.get(), sz - first } };
+
+			ssize_t n = writev(fd, iov, sz > first ? 2 : 1);
+
+			writes++;
+
+			if(n == -1) {
+				if(errno == EINTR)
+					continue;
+				n = sz;
+			}
+
+			tail.store(t + n, std::memory_order_release);
+		}
+	}
+}
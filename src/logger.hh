@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <memory>
+
+#include <cstdint>
+#include <cstddef>
+
+//
+// messages above this level are compiled out; 5 keeps everything
+//
+
+#ifndef JANK_LOG_LEVEL
+#define JANK_LOG_LEVEL 5
+#endif
+
+namespace jank {
+
+	//
+	// level-filtered messages handed to a background thread: post() copies
+	// the line into a byte ring and returns, and the thread writes whatever
+	// has queued with one writev per wakeup; one thread posts, and a full
+	// ring drops the line rather than stall the caller
+	//
+
+	class logger {
+
+		public:
+
+			enum class level : uint8_t { off, error, warn, info, debug, trace };
+
+			constexpr static level compiled = (level)JANK_LOG_LEVEL;
+
+			constexpr static size_t ring_size = 65536;
+
+			std::atomic<level> threshold;
+
+			std::atomic<unsigned long> posted;
+			std::atomic<unsigned long> dropped;
+			std::atomic<unsigned long> writes;
+
+			//
+			// callers check this before formatting anything
+			//
+
+			bool enabled(level l) const {
+				return l != level::off and l <= compiled and l <= threshold.load(std::memory_order_relaxed);
+			}
+
+			bool start(int);
+			bool stop();
+
+			bool post(level, const char *, size_t);
+			bool post(level, const char *);
+
+			static bool parse(const char *, level&);
+			static const char *name(level);
+
+			logger();
+			~logger();
+
+		private:
+
+			int fd;
+
+			std::unique_ptr<char[]> ring;
+
+			std::atomic<uint64_t> head;
+			std::atomic<uint64_t> tail;
+
+			std::atomic<uint32_t> wake;
+			std::atomic<bool> waiting;
+			std::atomic<bool> running;
+
+			std::thread drainer;
+
+			void put(uint64_t, const char *, size_t);
+			void drain();
+	};
+}
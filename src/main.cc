@@ -6,6 +6,7 @@
 #include <list>
 #include <span>
 #include <algorithm>
+#include <memory>
 
 #include <cstring>
 #include <cctype>
@@ -22,9 +23,22 @@
 #include <readline/history.h>
 
 #include <jank.hh>
+#include <format.hh>
+#include <batch.hh>
+#include <sink.hh>
+#include <dedup.hh>
+#include <reformat.hh>
+#include <journal.hh>
+#include <stream.hh>
+#include <retry.hh>
+#include <ring.hh>
+#include <model.hh>
 
 using namespace std::literals::string_literals;
 
+using jank::print_track;
+using jank::flash;
+
 namespace config {
 
 	bool verbose = false;
@@ -37,6 +51,20 @@ namespace config {
 	bool loco = false;
 	bool writemode = false;
 	const char *fmts = nullptr;
+	const char *sink_format = nullptr;
+	const char *sink_file = "-";
+	int sink_flush = -1;
+	bool dedup = false;
+	const char *dedup_file = nullptr;
+	const char *bulk_file = nullptr;
+	const char *journal_file = nullptr;
+	const char *verify = nullptr;
+	unsigned int bulk_threads = 0;
+	bool low_latency = false;
+	const char *baud = nullptr;
+	long reconnect_ms = 0;
+	const char *ring_file = nullptr;
+	jank::logger::level message_level = jank::logger::level::trace;
 
 	std::string track1;
 	std::string track2;
@@ -69,6 +97,7 @@ namespace config {
 
 		std::cout << "\t-t          toggle test mode (default="                     << (test      ? "ENABLED" : "DISABLED") << ")" << std::endl;
 		std::cout << "\t-v          toggle verbose mode (default="                  << (verbose   ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-m level    verbose message level: error, warn, info, debug or trace (default=" << jank::logger::name(message_level) << ")" << std::endl;
 		std::cout << "\t-i          toggle info mode (default="                     << (info      ? "ENABLED" : "DISABLED") << ")" << std::endl;
 		std::cout << "\t-c          toggle command-line mode (default="             << (cli       ? "ENABLED" : "DISABLED") << ")" << std::endl;
 		std::cout << "\t-D          toggle MSR-605 device detection mode (default=" << (detect    ? "ENABLED" : "DISABLED") << ")" << std::endl;
@@ -77,6 +106,19 @@ namespace config {
 		std::cout << "\t-a          toggle auto-retry mode (default="               << (autoretry ? "ENABLED" : "DISABLED") << ")" << std::endl;
 		std::cout << "\t-w          toggle write mode (default="                    << (writemode ? "ENABLED" : "DISABLED") << ")" << std::endl;
 		std::cout << "\t-r fmts     enable read mode using specified format string" << std::endl;
+		std::cout << "\t-x file     apply the -r format to every stored read in file or archive (- for stdin), no device needed" << std::endl;
+		std::cout << "\t-j threads  threads used by -x (default=all cores)" << std::endl;
+		std::cout << "\t-f format   READ/RAWRD record output format: jsonl, csv, bin or archive" << std::endl;
+		std::cout << "\t-o file     READ/RAWRD record output file (default=" << sink_file << ")" << std::endl;
+		std::cout << "\t-F cards    flush record output every n cards, 0 when full (default=1, archive=0)" << std::endl;
+		std::cout << "\t-u          toggle duplicate detection mode (default="           << (dedup     ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-U file     keep the duplicate index in file across sessions (implies -u)" << std::endl;
+		std::cout << "\t-V mode     verify every write by reading the card back: read or rawrd (parity and LRC)" << std::endl;
+		std::cout << "\t-k file     record T12/T1T2/T2 progress in file and resume from it" << std::endl;
+		std::cout << "\t-y          toggle low-latency serial mode (default="          << (low_latency ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-b rate     serial line rate, or probe to try faster rates first (default=9600)" << std::endl;
+		std::cout << "\t-R msec     reopen the device for up to msec after it hangs up, 0 to give up at once (default=" << reconnect_ms << ")" << std::endl;
+		std::cout << "\t-P file     publish reads, writes and erases to a shared-memory ring in file (see jank-tail)" << std::endl;
 		std::cout << "\t-1 track1   track1 data" << std::endl; 
 		std::cout << "\t-2 track2   track2 data" << std::endl; 
 		std::cout << "\t-3 track3   track3 data" << std::endl; 
@@ -110,7 +152,7 @@ namespace config {
 		int opt;
 		struct stat sb;
 
-		while((opt = getopt(argc, argv, "hvilatcDLd:wr:1:2:3:")) != -1) {
+		while((opt = getopt(argc, argv, "hvilatcDLuyU:k:V:b:R:P:m:d:wr:x:j:f:o:F:1:2:3:")) != -1) {
 
 			switch(opt) {
 
@@ -123,7 +165,24 @@ namespace config {
 				case 'l': loco	  = not loco    ; break;
 				case 'a': autoretry = not autoretry ; break;
 				case 'w': writemode = not writemode ; break;
+				case 'u': dedup = not dedup ; break;
+				case 'U': dedup_file = optarg; dedup = true; break;
+				case 'k': journal_file = optarg; break;
+				case 'V': verify = optarg; break;
+				case 'y': low_latency = not low_latency ; break;
+				case 'b': baud = optarg; break;
+				case 'P': ring_file = optarg; break;
+				case 'm':
+						  if(not jank::logger::parse(optarg, message_level))
+							  return false;
+						  break;
+				case 'R': reconnect_ms = std::max(0L, atol(optarg)); break;
 				case 'r': fmts = optarg; break;
+				case 'x': bulk_file = optarg; break;
+				case 'j': bulk_threads = atoi(optarg); break;
+				case 'f': sink_format = optarg; break;
+				case 'o': sink_file = optarg; break;
+				case 'F': sink_flush = atoi(optarg); break;
 				case '1': track1 = optarg; break;
 				case '2': track2 = optarg; break;
 				case '3': track3 = optarg; break;
@@ -157,10 +216,6 @@ volatile sig_atomic_t done = false;
 
 void signal_handler(int);
 void exit_handler();
-void flash(const jank::msr&, int, int);
-void print_track(unsigned int, const std::string&);
-void print_nbit(unsigned int, const std::string&, int);
-int charcount(const std::string&, char);
 
 bool write1();
 bool read1();
@@ -173,7 +228,7 @@ bool prefixmatch(const char *s, const char *p) {
 	return strncasecmp(s,p,n) == 0 && (isspace(s[n]) or s[n] == '\0');
 }
 
-bool retryWrite(const int& n, bool& cancel, jank::msr& msr, char default_choice) {
+bool retryWrite(const int& n, bool& cancel, jank::msr& msr, char& default_choice) {
 	auto en = errno;
 	std::cerr << "msr::write :: " << jank::msr::msr_strerror(msr.msr_errno) << std::endl;
 	std::cerr << "sys. error :: " << strerror(errno) << std::endl;
@@ -183,19 +238,31 @@ bool retryWrite(const int& n, bool& cancel, jank::msr& msr, char default_choice)
 		cancel = true;
 		return false;
 	} else {
-		char sre[16];
+		char sre[16] = {};
 		char choice = default_choice;
 
-		if(!choice) do {
-			std::cout << "(s)kip, (S)kip all, (r)etry, (R)etry all, (e/E)nd ? " << std::flush;
-		}  while(fgets(sre, sizeof(sre) - 1, stdin) != NULL and strchr("SRE", choice = toupper(*sre)) == NULL);
+		if(!choice) {
+			//
+			// no answer (end of input or an interrupt) ends the batch, as
+			// nobody is left to answer the next failure either; it is not
+			// remembered
+			//
+			do {
+				std::cout << "(s)kip, (S)kip all, (r)etry, (R)etry all, (e/E)nd ? " << std::flush;
+				if(fgets(sre, sizeof(sre) - 1, stdin) == NULL) {
+					*sre = '\0';
+					choice = 'E';
+					break;
+				}
+			}  while(strchr("SRE", choice = toupper(*sre)) == NULL);
 
-		if(choice == *sre)
-			default_choice = choice;
+			if(*sre != '\0' and choice == *sre)
+				default_choice = choice;
+		}
 
 		if(choice == 'S') {
 			std::cout << "OK, SKIPPING..." << std::endl;
-
+			return false;
 		} else if(choice == 'R') {
 			std::cout << "OK, RETRYING..." << std::endl;
 		} else if(choice == 'E') {
@@ -209,73 +276,35 @@ bool retryWrite(const int& n, bool& cancel, jank::msr& msr, char default_choice)
 	return true;
 }
 
-std::string format_read(const char *fmts, const std::string& t1, const std::string& t2) {
-	auto _B_ = jank::track::is_ok(t1) ? t1 : "-"s;
-	auto st2 = jank::track::is_ok(t2) ? t2 : "-"s;
-	auto as = st2.begin();
-	auto end2 = st2.end();
-	std::string _a_;
-	std::string _0m_;
-	std::string _m_;
-	std::string _0y_;
-	std::string _y_;
-	std::string _c_;
-
-	if(as != end2 and *as == ';') {
-		auto ae = ++as;
-		while(ae != end2 and *ae != '=')
-			ae++;
-		if(ae != end2 and *ae == '=') {
-			_a_ = std::string(as,ae);
-			auto ys = ae + 1;
-			auto ye = ys + 2;
-			auto y0 = ys;
-			auto ms = ye;
-			auto m0 = ms;
-			auto me = ms + 2;
-			if(*ys == '0')
-				ys++;
-			if(*ms == '0')
-				ms++;
-			if(me <= end2) {
-				_c_ = "20"s;
-				_0y_ = std::string(y0,ye);
-				_y_ = std::string(ys,ye);
-				_0m_ = std::string(m0,me);
-				_m_ = std::string(ms,me);
-			}
-		}
-	}
+void print_verified(const jank::batch& batch) {
+	std::cout << "/verify/ " << batch.dev.device << " verified=" << batch.st.verified << " rejected=" << batch.st.rejected << " yield=" << batch.st.yield() * 100 << "%" << std::endl;
+}
 
-	std::stringstream ss;
-	std::span sp(fmts, strlen(fmts));
+void print_io(const jank::msr& msr) {
+	std::cout << "/io/ baud=" << msr.baud << " low-latency=" << (msr.low_latency ? "ON" : "OFF") << " wakeups=" << msr.io.wakeups << " reads=" << msr.io.reads;
+	std::cout << " bytes=" << msr.io.bytes << " responses=" << msr.io.responses << " wakeups/response=" << msr.io.per_response();
+	std::cout << " reconnects=" << msr.io.reconnects << std::endl;
 
-	for(auto it = sp.begin(); it != sp.end(); it++) {
-		if(*it == '%') {
-			if(++it == sp.end()) {
-				ss.put('%');
-				break;
-			}
-			bool _0_ = (*it == '0');
-			if(_0_)
-				it++;
-			switch(*it) {
-				case 'c': ss << _c_; break;
-				case 'y': ss << (_0_ ? _0y_ : _y_); break;
-				case 'm': ss << (_0_ ? _0m_ : _m_); break;
-				case 'a': ss << _a_; break;
-				case 'B': ss << _B_; break;
-				case ';': ss << st2; break;
-				case '%': ss.put('%'); break;
-			}
-		} else {
-			ss.put(*it);
-		}
-	}
+	auto arena = msr.arena();
+
+	std::cout << "/arena/ size=" << jank::msr::arena_size << " commands=" << arena.commands << " spills=" << arena.spills << " spill_bytes=" << arena.spill_bytes << std::endl;
 
-	return ss.str();
+	std::cout << "/log/ level=" << jank::logger::name(msr.messages.threshold) << " posted=" << msr.messages.posted << " dropped=" << msr.messages.dropped << " writes=" << msr.messages.writes << std::endl;
 }
 
+void print_yield(const jank::retry_policy& policy) {
+
+	using failure = jank::retry_policy::failure;
+
+	std::cout << "/yield/ " << policy.st.yield() * 100 << "% first_pass=" << policy.st.first_pass << " recovered=" << policy.st.recovered;
+	std::cout << " skipped=" << policy.st.skipped << " stopped=" << policy.st.stopped << " retries=" << policy.st.retries << " waited_ms=" << policy.st.waited_ms;
+
+	for(size_t f = 0; f < (size_t)failure::count; f++)
+		if(policy.st.failures[f] > 0)
+			std::cout << ' ' << jank::retry_policy::name((failure)f) << '=' << policy.st.failures[f];
+
+	std::cout << std::endl;
+}
 
 int main(int argc, char **argv) {
 
@@ -295,6 +324,28 @@ int main(int argc, char **argv) {
 		return EXIT_FAILURE;
 	}
 
+	if(config::bulk_file != nullptr) {
+
+		if(config::fmts == nullptr) {
+			std::cerr << "bulk reformatting needs a format string (specify using -r flag)" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		jank::reformat bulk(config::fmts);
+
+		bulk.threads = config::bulk_threads;
+
+		if(not bulk.run(config::bulk_file, STDOUT_FILENO)) {
+			perror(config::bulk_file);
+			return EXIT_FAILURE;
+		}
+
+		if(config::verbose)
+			std::cerr << "records=" << bulk.records << " chunks=" << bulk.chunks << std::endl;
+
+		return EXIT_SUCCESS;
+	}
+
 	if(config::device == nullptr) {
 		std::cerr << "msr device filename not found (specify using -d flag)" << std::endl;
 		return EXIT_FAILURE;
@@ -336,21 +387,47 @@ int main(int argc, char **argv) {
 	if(config::verbose)
 		std::cout << "[START]" << std::endl;
 
+	bool probe = config::baud != nullptr and strcasecmp(config::baud, "probe") == 0;
+
+	msr.low_latency = config::low_latency;
+	msr.reconnect_ms = config::reconnect_ms;
+
+	//
+	// without -v nothing is formatted or queued at all
+	//
+
+	msr.messages.threshold = config::verbose ? config::message_level : jank::logger::level::off;
+
+	if(config::baud != nullptr and not probe)
+		msr.baud = atol(config::baud);
+
 	if(msr.start(config::device, oob_fd, msg_fd) == false) {
 		std::cerr << "failed to start device " << config::device << ": " << strerror(errno) << std::endl;
 		return EXIT_FAILURE;
 	}
 
-	if(not msr.reset()) {
-		perror("RESET");
-		return EXIT_FAILURE;
-	}
+	if(probe and msr.probe({ 230400, 115200, 57600, 38400, 19200, jank::msr::default_baud }) == 0)
+		perror("PROBE");
 
 	if(config::detect) {
 		msr.sync_timeout = 1;
+		if(not msr.reset())
+			return EXIT_FAILURE;
 		return msr.model() == '\0' ? EXIT_FAILURE : EXIT_SUCCESS;
 	}
 
+	//
+	// reset, coercivity, model and firmware go out as one write; a device
+	// that answers any of them differently falls back to one at a time
+	//
+
+	bool ready = msr.setup(not config::loco);
+
+	if(not ready and not msr.reset()) {
+		perror("RESET");
+		return EXIT_FAILURE;
+	}
+
 	if(config::led) {
 		flash(msr, 4, 100);
 	}
@@ -381,6 +458,13 @@ int main(int argc, char **argv) {
 		if(msr.has_track3()) std::cout << '3';
 
 		std::cout << std::endl;
+
+		jank::model::dispatch(model, [](auto m) {
+			std::cout << "frame=" << decltype(m)::read_frame_max << std::endl;
+			std::cout << "coercivity=" << (decltype(m)::coercivity ? "hico/loco" : "fixed") << std::endl;
+		});
+
+		print_io(msr);
 	}
 
 	if(config::test) {
@@ -394,7 +478,9 @@ int main(int argc, char **argv) {
 		std::cout << "RAM-test: "    << (msr.test_ram   () ? "PASS" : "FAIL") << std::endl;
 	}
 
-	if(config::loco) {
+	if(ready) {
+		// coercivity was set by setup
+	} else if(config::loco) {
 		msr.set_loco();
 	} else {
 		msr.set_hico();
@@ -406,7 +492,8 @@ int main(int argc, char **argv) {
 		exit(msr.write(config::track1,config::track2,config::track3) ? EXIT_SUCCESS : EXIT_FAILURE);
 	if(config::fmts != nullptr) {
 		if(msr.read(config::track1,config::track2,config::track3)) {
-			std::cout << format_read(config::fmts, config::track1, config::track2) << std::endl;
+			jank::format_program program(config::fmts);
+			std::cout << program.apply(config::track1, config::track2) << std::endl;
 			exit(EXIT_SUCCESS);
 		}
 		exit(EXIT_FAILURE);
@@ -421,6 +508,145 @@ int main(int argc, char **argv) {
 
 		snprintf(prompt, sizeof(prompt), "%s> ", msr.firmware());
 
+		jank::batch batch(msr);
+
+		batch.interrupt_fd = STDIN_FILENO;
+
+		jank::retry_policy policy;
+
+		if(config::verify != nullptr) {
+			if(strcmp(config::verify, "read") == 0) {
+				batch.verify = jank::batch::verify_mode::read;
+			} else if(strcmp(config::verify, "rawrd") == 0) {
+				batch.verify = jank::batch::verify_mode::rawrd;
+			} else {
+				std::cerr << "unknown verify mode " << config::verify << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+
+		std::unique_ptr<jank::sink> sink;
+
+		if(config::sink_format != nullptr) {
+
+			jank::sink::format format;
+
+			int fd = STDOUT_FILENO;
+
+			if(not jank::sink::parse_format(config::sink_format, format)) {
+				std::cerr << "unknown record format " << config::sink_format << std::endl;
+				return EXIT_FAILURE;
+			}
+
+			if(strcmp(config::sink_file, "-") == 0) {
+				std::cout.rdbuf(std::cerr.rdbuf());
+				rl_outstream = stderr;
+			} else {
+				fd = open(config::sink_file, O_WRONLY | O_CREAT | (format == jank::sink::format::archive ? O_TRUNC : O_APPEND), 0644);
+				if(fd == -1) {
+					perror(config::sink_file);
+					return EXIT_FAILURE;
+				}
+			}
+
+			sink = std::make_unique<jank::sink>(fd, format);
+			if(config::sink_flush >= 0)
+				sink->flush_every = config::sink_flush;
+
+			batch.out = sink.get();
+		}
+
+		jank::dedup index;
+
+		if(config::dedup) {
+
+			if(not index.open(config::dedup_file)) {
+				perror(config::dedup_file ? config::dedup_file : "duplicate index");
+				return EXIT_FAILURE;
+			}
+
+			batch.index = &index;
+		}
+
+		jank::journal progress;
+
+		if(config::journal_file != nullptr) {
+
+			if(not progress.open(config::journal_file)) {
+				perror(config::journal_file);
+				return EXIT_FAILURE;
+			}
+
+			batch.progress = &progress;
+		}
+
+		jank::ring events;
+
+		if(config::ring_file != nullptr) {
+
+			if(not events.create(config::ring_file)) {
+				perror(config::ring_file);
+				return EXIT_FAILURE;
+			}
+
+			batch.events = &events;
+		}
+
+		//
+		// runs a batch command on its input; input "-" takes stdin, which
+		// is also where ENTER cancels and retry answers come from, so for
+		// that job the device's cancel input moves to /dev/null and failed
+		// writes follow the retry policy, there being nobody left to ask
+		//
+
+		auto job = [&](const char *fn, auto run) {
+
+			bool from_stdin = strcmp(fn, "-") == 0;
+
+			int fd = jank::open_input(fn);
+			if(fd == -1) {
+				perror(fn);
+				return;
+			}
+
+			int null_fd = -1;
+			int prev_oob_fd = -1;
+
+			if(from_stdin) {
+
+				null_fd = open("/dev/null", O_RDONLY);
+				if(null_fd == -1) {
+					perror("open(\"/dev/null\", O_RDONLY)");
+					close(fd);
+					return;
+				}
+
+				prev_oob_fd = msr.interrupt(null_fd);
+				batch.interrupt_fd = -1;
+
+				std::cout << "input on stdin: <ENTER> does not cancel and failed writes are retried automatically." << std::endl;
+			}
+
+			char default_choice = '\0';
+			batch.policy = config::runtime::autoretry or from_stdin ? &policy : nullptr;
+			batch.retry = [&](int n, bool& cancel, jank::msr& msr) { return retryWrite(n, cancel, msr, default_choice); };
+
+			run(fd);
+
+			close(fd);
+
+			if(from_stdin) {
+				msr.interrupt(prev_oob_fd);
+				batch.interrupt_fd = STDIN_FILENO;
+				close(null_fd);
+			}
+
+			if(batch.policy != nullptr)
+				print_yield(policy);
+			if(batch.verify != jank::batch::verify_mode::none)
+				print_verified(batch);
+		};
+
 		std::cout << "/cli-mode/" << std::endl;
 
 		while(not done and (line = readline(prompt)) != nullptr) {
@@ -435,22 +661,7 @@ int main(int argc, char **argv) {
 					t1 = t2 = t3 = true;
 				}
 
-				int n = 0;
-
-				std::cout << "/batch-erase-";
-				if(t1) std::cout << '1';
-				if(t2) std::cout << '2';
-				if(t3) std::cout << '3';
-				std::cout << '/' << std::endl;
-
-				msr.flush();
-
-				do {
-					std::cout << "[" << ++n << "] swipe card or press <ENTER> to stop." << std::endl;
-					flash(msr, 3, 50);
-				} while(msr.erase(t1,t2,t3));
-
-				perror("ERASE");
+				batch.erase(t1, t2, t3);
 
 			} else if(prefixmatch(line, "WRITE")) {
 				char tr[3][128] = { "", "", "" };
@@ -477,211 +688,48 @@ int main(int argc, char **argv) {
 
 			} else if(prefixmatch(line, "COPY")) {
 
-				bool done = false;
-
-				std::string track1;
-				std::string track2;
-				std::string track3;
-
-				std::cout << "/copy/" << std::endl;
-
-				while(not done) {
-
-					std::cout << "swipe read card or press <ENTER> to cancel." << std::endl;
-
-					if(msr.read(track1, track2, track3)) {
-
-						print_track(1, track1);
-						print_track(2, track2);
-						print_track(3, track3);
+				batch.copy();
 
-						if(not track1.empty() and track1.front() == '%' and track1.back() == '?')
-							track1 = track1.substr(1, std::string::npos);
+				if(batch.verify != jank::batch::verify_mode::none)
+					print_verified(batch);
 
-						msleep(500);
-
-						while(not done) {
-
-							std::cout << "swipe writ/ card or press <ENTER> to cancel." << std::endl;
-
-							if(msr.write(track1, track2, track3)) {
-
-								done = true;
-
-							} else {
-
-								std::cerr << "msr::write :: " << jank::msr::msr_strerror(msr.msr_errno) << std::endl;
-								std::cerr << "sys. error :: " << strerror(errno) << std::endl;
-
-								if(errno == ECANCELED or errno == EINVAL)
-									break;
-							}
-
-							msleep(500);
-						}
-
-					} else {
-
-						std::cerr << "msr::read  :: " << jank::msr::msr_strerror(msr.msr_errno) << std::endl;
-						std::cerr << "sys. error :: " << strerror(errno) << std::endl;
-
-						if(errno == ECANCELED)
-							break;
-					}
-
-					msleep(500);
-				}
 			} else if(prefixmatch(line, "T12")) {
-				int n = 0;
 				char fn[256];
 				int first_n = 1;
 				int k = sscanf(line, "%*s %255s %d", fn, &first_n);
 
-				if(k > 0) {
-					FILE *f = fopen(fn, "r");
-					if(f == NULL) {
-						perror("fopen()");
-					} else {
-						bool cancel = false;
-						char fileline[256];
-						char default_choice = config::runtime::autoretry ? 'R' : '\0';
-						std::cout << "/batch-write-track12/" << std::endl;
-						while(not cancel and fgets(fileline, sizeof(fileline) - 1, f) != NULL) {
-
-							std::string s(fileline);
-							auto pos = s.find('\t');
-							std::string t1(s.begin(), s.begin() + pos);
-							std::string t2(s.begin() + pos + 1, s.end() - 1);
-							std::cout << "[" << ++n << "] track1 = " << t1 << " track2 = " << t2;
-							if(n < first_n) {
-								std::cout << " : skipping" << std::endl;
-							} else {
-								std::cout << std::endl;
-								std::cout << "[" << n << "] TRACK1 swipe card or press <ENTER> to stop." << std::endl;
-
-								while(not msr.write(t1, t2, "") and retryWrite(n,cancel,msr,default_choice));
-
-								msleep(500);
-							}
-						}
-					}
-				}
+				if(k > 0)
+					job(fn, [&](int fd) { batch.t12(fd, first_n); });
 
 			} else if(prefixmatch(line, "T1T2")) {
-				int n = 0;
 				char fn[256];
 				int first_n = 1;
 				int k = sscanf(line, " %*s %255s %d ", fn, &first_n);
 
-				if(k > 0) {
-					FILE *f = fopen(fn, "r");
-					if(f == NULL) {
-						perror("fopen()");
-					} else {
-						bool cancel = false;
-						char fileline[256];
-						char default_choice = config::runtime::autoretry ? 'R' : '\0';
-						std::cout << "/batch-write-track12/" << std::endl;
-						while(not cancel and fgets(fileline, sizeof(fileline) - 1, f) != NULL) {
-
-							std::string s(fileline);
-							auto pos = s.find('\t');
-							std::string t1(s.begin(), s.begin() + pos);
-							std::string t2(s.begin() + pos + 1, s.end() - 1);
-							std::cout << std::endl;
-							std::cout << "[" << ++n << "] track1 = " << t1 << " track2 = " << t2;
-							if(n < first_n) {
-								std::cout << " : skipping" << std::endl;
-							} else {
-								std::cout << std::endl;
-								std::cout << "[" << n << "] swipe card or press <ENTER> to stop." << std::endl;
-
-								std::cout << "[" << n << "] swipe for track1 = " << t1 << std::endl;
-								while(not msr.write(t1, "", "") and retryWrite(n,cancel,msr,default_choice));
-
-								msleep(500);
-
-								std::cout << std::endl;
-
-								if(not cancel) {
-									std::cout << "[" << n << "] swipe for track2 = " << t2 << std::endl;
-									while(not msr.write("", t2, "") and retryWrite(n,cancel,msr,default_choice));
-								}
-
-								msleep(500);
-							}
-						}
-					}
-				}
+				if(k > 0)
+					job(fn, [&](int fd) { batch.t1t2(fd, first_n); });
 			} else if(prefixmatch(line, "TRACK2") || prefixmatch(line, "T2")) {
-				int n = 0;
 				char fn[256];
 				int first_n = 1;
 				int k = sscanf(line, " %*s %255s %d ", fn, &first_n);
 
+				if(k > 0)
+					job(fn, [&](int fd) { batch.t2(fd, first_n); });
+			} else if(prefixmatch(line, "JOB")) {
+				char fn[256];
+				char mode[16] = "";
+				int k = sscanf(line, " %*s %255s %15s ", fn, mode);
+
 				if(k > 0) {
-					FILE *f = fopen(fn, "r");
-					if(f == NULL) {
-						perror("fopen()");
-					} else {
-						bool cancel = false;
-						char fileline[256];
-						char default_choice = config::runtime::autoretry ? 'R' : '\0';
-						std::cout << "/batch-write-track2/" << std::endl;
-						while(not cancel and fgets(fileline, sizeof(fileline) - 1, f) != NULL) {
-
-							std::string s(fileline);
-							std::smatch m;
-							std::regex e ("\\b\\d{15,19}=\\d{4,60}\\b");
-
-							while (not cancel and std::regex_search (s,m,e)) {
-								auto track2 = m.str();
-
-								std::cout << "[" << ++n << "] track2 = " << track2;
-								if(n < first_n) {
-									std::cout << " : skipping" << std::endl;
-								} else {
-									std::cout << std::endl;
-									std::cout << "[" << n << "] swipe card or press <ENTER> to stop." << std::endl;
-
-									while(not msr.write("", track2, "") and retryWrite(n,cancel,msr,default_choice));
-
-									msleep(500);
-								}
-								s = m.suffix().str();
-							}
-						}
-					}
+					job(fn, [&](int fd) {
+						batch.job(fd, strcasecmp(mode, "SPLIT") == 0, not config::loco);
+						std::cout << "/job/ coercivity-switches=" << batch.st.switches << std::endl;
+					});
 				}
 			} else if(prefixmatch(line, "READ")) {
 
-				int n = 0;
-
-				std::string track1;
-				std::string track2;
-				std::string track3;
-
-				std::cout << "/batch-read/" << std::endl;
-
-				for(;;) {
-
-					std::cout << '[' << (++n) << "] swipe card or press <ENTER> to stop." << std::endl;
-
-					if(!msr.read(track1, track2, track3)) {
-
-						std::cerr << "msr::read  :: " << jank::msr::msr_strerror(msr.msr_errno) << std::endl;
-						std::cerr << "sys. error :: " << strerror(errno) << std::endl;
-
-						if(errno == ECANCELED)
-							break;
-					}
-
-					print_track(1, track1);
-					print_track(2, track2);
-					print_track(3, track3);
+				batch.read();
 
-					msleep(500);
-				}
 			} else if(prefixmatch(line, "RAWRD")) {
 
 				int t1, t2, t3;
@@ -692,33 +740,7 @@ int main(int argc, char **argv) {
 					t3 = 5;
 				}
 
-				int n = 0;
-
-				std::string track1;
-				std::string track2;
-				std::string track3;
-
-				std::cout << "/batch-rawrd-" << t1 << t2 << t3 << "/" << std::endl;
-
-				for(;;) {
-
-					std::cout << '[' << (++n) << "] swipe card or press <ENTER> to stop." << std::endl;
-
-					if(!msr.rawrd(track1, track2, track3)) {
-
-						std::cerr << "msr::rawrd :: " << jank::msr::msr_strerror(msr.msr_errno) << std::endl;
-						std::cerr << "sys. error :: " << strerror(errno) << std::endl;
-
-						if(errno == ECANCELED)
-							break;
-					}
-
-					if(not track1.empty()) print_nbit(1, track1, t1);
-					if(not track2.empty()) print_nbit(2, track2, t2);
-					if(not track3.empty()) print_nbit(3, track3, t3);
-
-					msleep(500);
-				}
+				batch.rawrd(t1, t2, t3);
 
 			} else if(prefixmatch(line, "HICO")) {
 				msr.set_hico();
@@ -740,6 +762,8 @@ int main(int argc, char **argv) {
 				msr.off();
 			} else if(prefixmatch(line, "RESET")) {
 				msr.reset();
+			} else if(prefixmatch(line, "IO")) {
+				print_io(msr);
 			} else if(prefixmatch(line, "QUIT")) {
 				done = true;
 			} else if(prefixmatch(line, "AUTORETRY") || prefixmatch(line, "AUTO")) {
@@ -752,66 +776,6 @@ int main(int argc, char **argv) {
 
 	return EXIT_SUCCESS;
 }
-std::string binary(const std::string& s) {
-	std::string t;
-	for(int i = 0; i < (int)s.length(); i++) {
-		unsigned char ch = (unsigned char)s[i];
-		for(int b = 7; b >= 0; b--)
-			t.push_back(ch & (1 << b) ? '1' : '0');
-	}
-
-	return t;
-}
-
-int charcount(const std::string& s, char ch) {
-	int num = 0;
-	for(char ds : s)
-		if(ds == ch)
-			num++;
-	return num;
-}
-
-void print_nbit(unsigned int track_no, const std::string& track, int num_bits) {
-	auto bits = binary(track);
-	std::cout << "track" << track_no << " (" << jank::track::status(track) << ") :: " << std::dec << ((int)track.length()) << ' ' << num_bits <<"-bit symbols :=";
-	if(jank::track::is_ok(track)) {
-		while(not bits.empty()) {
-			int min_bits = std::min(num_bits, (int)bits.length());
-			auto front = bits.substr(0, min_bits);
-			bits = bits.substr(min_bits, std::string::npos);
-			int parity0 = front.back() - '0';
-			front.pop_back();
-			std::reverse(front.begin(), front.end());
-			int parity1 = charcount(front,'1') & 1 ? 0 : 1;
-			int val = stoul(front, nullptr, 2);
-			char ch = val + (num_bits == 5 ? '0' : ' ');
-			if(parity0 == parity1)
-				std::cout << ch;
-			else
-				std::cout  << " \033[31m" << ch << "\033[0m";
-		}
-		std::cout << std::endl;
-	}
-	std::cout << std::endl;
-}
-
-void print_track(unsigned int no, const std::string& track) {
-	std::cout << "track" << no << " (" << jank::track::status(track) << ')';
-	if(jank::track::is_ok(track))
-		std::cout << ' ' << track;
-	std::cout << std::endl;
-}
-
-void flash(const jank::msr& msr, int n, int ms) {
-	for(int y = 0; y < n; y++) {
-		msleep(ms);
-		msr.on();
-		msleep(ms);
-		msr.off();
-	}
-	msleep(ms);
-}
-
 void exit_handler() {
 }
 
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <string>
+
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+
+#include <jank.hh>
+
+namespace jank {
+
+	namespace model {
+
+		//
+		// what a device family can do, fixed at compile time: the model
+		// digit it answers ESC t with, its tracks, whether it takes the
+		// coercivity commands, and the largest frames it sends
+		//
+
+		template <char Id, bool T1, bool T2, bool T3, bool Coercivity = true> struct traits {
+
+			constexpr static char id = Id;
+
+			constexpr static bool track1 = T1;
+			constexpr static bool track2 = T2;
+			constexpr static bool track3 = T3;
+
+			constexpr static bool coercivity = Coercivity;
+
+			constexpr static uint8_t tracks = (T1 ? 1 : 0) | (T2 ? 2 : 0) | (T3 ? 4 : 0);
+
+			constexpr static bool has(int no) {
+				return no >= 1 and no <= 3 and (tracks & (1 << (no - 1)));
+			}
+
+			//
+			// ESC s, then ESC n and the track or ESC + per track, then
+			// ? FS ESC status; ISO 7811 track lengths with sentinels
+			//
+
+			constexpr static size_t track_max[3] = { 79, 40, 107 };
+
+			constexpr static size_t read_frame_max = 2 + (T1 ? 2 + track_max[0] : 4) + (T2 ? 2 + track_max[1] : 4) + (T3 ? 2 + track_max[2] : 4) + 4;
+
+			constexpr static size_t rawrd_frame_max = 2 + 3 * (3 + 255) + 4;
+		};
+
+		//
+		// the MSR206 variants are built for one coercivity and have no
+		// ESC x / ESC y
+		//
+
+		using msr605 = traits<'3', true, true, true>;
+		using msr206_12 = traits<'5', true, true, false, false>;
+		using msr206_23 = traits<'2', false, true, true, false>;
+		using msr206_2 = traits<'1', false, true, false, false>;
+
+		//
+		// the same facts at run time, for a device known only by the digit
+		// it reported
+		//
+
+		struct profile {
+			char id;
+			uint8_t tracks;
+			bool coercivity;
+			size_t read_frame_max;
+		};
+
+		template <class Model> constexpr profile profile_of() {
+			return { Model::id, Model::tracks, Model::coercivity, Model::read_frame_max };
+		}
+
+		constexpr profile profiles[] = {
+			profile_of<msr605>(),
+			profile_of<msr206_12>(),
+			profile_of<msr206_23>(),
+			profile_of<msr206_2>(),
+		};
+
+		constexpr const profile *lookup(char id) {
+			for(const profile& p : profiles)
+				if(p.id == id)
+					return &p;
+			return nullptr;
+		}
+
+		//
+		// calls f with a value of the traits type matching the reported
+		// digit, so auto-detected devices reach the same specialised code;
+		// false when the digit is not a known model
+		//
+
+		template <class F> bool dispatch(char id, F&& f) {
+			switch(id) {
+				case msr605::id:    f(msr605());    return true;
+				case msr206_12::id: f(msr206_12()); return true;
+				case msr206_23::id: f(msr206_23()); return true;
+				case msr206_2::id:  f(msr206_2());  return true;
+			}
+			return false;
+		}
+
+		//
+		// an msr for code that knows its model when it is compiled; track
+		// checks are constants and commands the model cannot run do not
+		// compile; the base is private so nothing can reach the unchecked
+		// commands through a jank::msr&, and the commands every model has
+		// are passed through as they are
+		//
+
+		template <class Model> class msr : private jank::msr {
+
+			public:
+
+				using traits = Model;
+
+				using jank::msr::view_type;
+				using jank::msr::led;
+				using jank::msr::io_stats;
+				using jank::msr::arena_stats;
+
+				using jank::msr::active;
+				using jank::msr::device;
+				using jank::msr::sync_timeout;
+				using jank::msr::msr_errno;
+				using jank::msr::baud;
+				using jank::msr::low_latency;
+				using jank::msr::reconnect_ms;
+				using jank::msr::io;
+				using jank::msr::trace;
+				using jank::msr::messages;
+
+				using jank::msr::start;
+				using jank::msr::stop;
+				using jank::msr::sync;
+				using jank::msr::flush;
+				using jank::msr::reset;
+				using jank::msr::red;
+				using jank::msr::yellow;
+				using jank::msr::green;
+				using jank::msr::on;
+				using jank::msr::off;
+				using jank::msr::signal;
+				using jank::msr::idle;
+				using jank::msr::read;
+				using jank::msr::rawrd;
+				using jank::msr::cancel;
+				using jank::msr::test_comm;
+				using jank::msr::test_ram;
+				using jank::msr::test_sensor;
+				using jank::msr::firmware;
+				using jank::msr::arena;
+				using jank::msr::hex;
+
+				constexpr static bool has_track1() { return Model::track1; }
+				constexpr static bool has_track2() { return Model::track2; }
+				constexpr static bool has_track3() { return Model::track3; }
+
+				constexpr static char model() {
+					return Model::id;
+				}
+
+				//
+				// asks the device once and fails when it is another model
+				//
+
+				bool identify() {
+					char m = jank::msr::model();
+					if(m != Model::id) {
+						if(m != '\0')
+							errno = ENODEV;
+						return false;
+					}
+					return true;
+				}
+
+				bool set_hico() {
+					static_assert(Model::coercivity, "model has no coercivity commands");
+					return jank::msr::set_hico();
+				}
+
+				bool set_loco() {
+					static_assert(Model::coercivity, "model has no coercivity commands");
+					return jank::msr::set_loco();
+				}
+
+				template <bool T1, bool T2, bool T3> bool erase() {
+					static_assert((not T1 or Model::track1) and (not T2 or Model::track2) and (not T3 or Model::track3), "model lacks a track to erase");
+					return jank::msr::erase(T1, T2, T3);
+				}
+
+				bool erase() {
+					return jank::msr::erase(Model::track1, Model::track2, Model::track3);
+				}
+
+				template <int No> bool write(const std::string& data) {
+					static_assert(Model::has(No), "model lacks the track to write");
+					return jank::msr::write(No == 1 ? data : "", No == 2 ? data : "", No == 3 ? data : "");
+				}
+
+				//
+				// tracks the model does not have are dropped rather than
+				// sent for the device to reject
+				//
+
+				bool write(const std::string& t1, const std::string& t2, const std::string& t3) {
+					return jank::msr::write(Model::track1 ? t1 : "", Model::track2 ? t2 : "", Model::track3 ? t3 : "");
+				}
+
+				msr() {
+					reserve(2 * Model::rawrd_frame_max);
+				}
+		};
+	}
+}
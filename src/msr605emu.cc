@@ -0,0 +1,248 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <emu.hh>
+
+namespace config {
+
+	bool verbose = false;
+	bool loco = false;
+	unsigned long seed = 1;
+	const char *link = nullptr;
+	int port = 0;
+
+	int argc;
+	char **argv;
+
+	jank::emu emu;
+
+	void usage() {
+
+		std::string prog = basename(argv[0]);
+
+		std::cout << std::endl << "usage: " << prog << " [options]" << std::endl << std::endl;
+
+		std::cout << "\t-h          show this help" << std::endl;
+		std::cout << "\t-v          toggle verbose mode (default="   << (verbose ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-l          toggle LO-CO mode (default="     << (loco    ? "ENABLED" : "DISABLED") << ")" << std::endl;
+		std::cout << "\t-B baud     per-byte delay for the given baud rate, 10 bits per byte" << std::endl;
+		std::cout << "\t-b usec     per-byte delay in microseconds (default=" << emu.byte_delay << ")" << std::endl;
+		std::cout << "\t-s msec     swipe delay in milliseconds (default=" << emu.swipe_delay << ")" << std::endl;
+		std::cout << "\t-e rate     swipe error injection probability (default=" << emu.error_rate << ")" << std::endl;
+		std::cout << "\t-E status   injected error status 1, 2, 4 or 9 (default=" << emu.error_status << ")" << std::endl;
+		std::cout << "\t-T rate     swipe reply truncation probability (default=" << emu.truncate_rate << ")" << std::endl;
+		std::cout << "\t-m model    model digit reported by ESC t (default=" << emu.model_id << ")" << std::endl;
+		std::cout << "\t-f rev      firmware reported by ESC v (default=" << emu.firmware << ")" << std::endl;
+		std::cout << "\t-S seed     random seed (default=" << seed << ")" << std::endl;
+		std::cout << "\t-L path     create a symbolic link to the pty at path" << std::endl;
+		std::cout << "\t-p port     also serve the device as a raw TCP serial bridge on 127.0.0.1:port" << std::endl;
+		std::cout << "\t-1 track1   track1 data on the emulated card" << std::endl;
+		std::cout << "\t-2 track2   track2 data on the emulated card" << std::endl;
+		std::cout << "\t-3 track3   track3 data on the emulated card" << std::endl;
+
+		std::cout << std::endl;
+	}
+
+	void init(int my_argc, char **my_argv) {
+
+		argc = my_argc;
+		argv = my_argv;
+	}
+
+	bool parse() {
+
+		int opt;
+
+		while((opt = getopt(argc, argv, "hvlB:b:s:e:E:T:m:f:S:L:p:1:2:3:")) != -1) {
+
+			switch(opt) {
+
+				case 'v': verbose = not verbose ; break;
+				case 'l': loco    = not loco    ; break;
+				case 'B': emu.byte_delay = 10000000L / std::max(1L, atol(optarg)); break;
+				case 'b': emu.byte_delay = atol(optarg); break;
+				case 's': emu.swipe_delay = atol(optarg); break;
+				case 'e': emu.error_rate = atof(optarg); break;
+				case 'E': emu.error_status = *optarg; break;
+				case 'T': emu.truncate_rate = atof(optarg); break;
+				case 'm': emu.model_id = *optarg; break;
+				case 'f': emu.firmware = optarg; break;
+				case 'S': seed = strtoul(optarg, nullptr, 0); break;
+				case 'L': link = optarg; break;
+				case 'p': port = atoi(optarg); break;
+				case '1': emu.track1 = optarg; break;
+				case '2': emu.track2 = optarg; break;
+				case '3': emu.track3 = optarg; break;
+
+				case 'h':
+				default:
+						  return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+void signal_handler(int);
+
+//
+// stands in for a networked serial server: one client at a time, bytes
+// relayed unchanged between the socket and the pty
+//
+
+bool relay(int a, int b) {
+
+	char block[4096];
+
+	ssize_t n = read(a, block, sizeof(block));
+	if(n <= 0)
+		return false;
+
+	for(ssize_t done = 0; done < n; ) {
+		ssize_t m = write(b, block + done, n - done);
+		if(m <= 0)
+			return false;
+		done += m;
+	}
+
+	return true;
+}
+
+int bridge(const std::string& device, int port) {
+
+	sockaddr_in sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int one = 1;
+
+	int server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(server == -1)
+		return -1;
+
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if(bind(server, (sockaddr *)&sa, sizeof(sa)) == -1 or listen(server, 1) == -1) {
+		close(server);
+		return -1;
+	}
+
+	std::thread([=] {
+
+		for(;;) {
+
+			int client = accept(server, nullptr, nullptr);
+			if(client == -1)
+				continue;
+
+			int tty = open(device.c_str(), O_RDWR | O_NOCTTY);
+
+			termios options;
+
+			if(tty != -1 and tcgetattr(tty, &options) == 0) {
+				cfmakeraw(&options);
+				tcsetattr(tty, TCSANOW, &options);
+			}
+
+			pollfd pfd[2] = { { client, POLLIN, 0 }, { tty, POLLIN, 0 } };
+
+			while(tty != -1 and poll(pfd, 2, -1) > 0) {
+				if((pfd[0].revents & (POLLIN | POLLHUP)) and not relay(client, tty))
+					break;
+				if((pfd[1].revents & POLLIN) and not relay(tty, client))
+					break;
+			}
+
+			if(tty != -1)
+				close(tty);
+
+			close(client);
+		}
+
+	}).detach();
+
+	return server;
+}
+
+int main(int argc, char **argv) {
+
+	auto& emu = config::emu;
+
+	config::init(argc, argv);
+
+	if(not config::parse()) {
+		config::usage();
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	emu.hico = not config::loco;
+
+	if(config::verbose)
+		emu.msg_fd = STDOUT_FILENO;
+
+	if(not emu.start(config::seed)) {
+		perror("msr605emu");
+		return EXIT_FAILURE;
+	}
+
+	if(config::link != nullptr) {
+		unlink(config::link);
+		if(symlink(emu.device.c_str(), config::link) == -1) {
+			perror("symlink()");
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::cout << "device=" << emu.device << std::endl;
+
+	if(config::port > 0) {
+		if(bridge(emu.device, config::port) == -1) {
+			perror("bridge");
+			return EXIT_FAILURE;
+		}
+		std::cout << "bridge=tcp:127.0.0.1:" << config::port << std::endl;
+	}
+
+	if(not emu.run()) {
+		perror("msr605emu");
+		return EXIT_FAILURE;
+	}
+
+	if(config::link != nullptr)
+		unlink(config::link);
+
+	if(config::verbose) {
+		std::cout << "commands="    << emu.stats.commands    << std::endl;
+		std::cout << "swipes="      << emu.stats.swipes      << std::endl;
+		std::cout << "errors="      << emu.stats.errors      << std::endl;
+		std::cout << "truncations=" << emu.stats.truncations << std::endl;
+		std::cout << "bytes_in="    << emu.stats.bytes_in    << std::endl;
+		std::cout << "bytes_out="   << emu.stats.bytes_out   << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void signal_handler(int signo) {
+	config::emu.halt();
+}
@@ -0,0 +1,114 @@
+#include <string>
+#include <algorithm>
+
+#include <strings.h>
+
+#include <jank.hh>
+#include <plan.hh>
+
+namespace jank {
+
+	plan::plan() : lines(0) {
+	}
+
+	char plan::coercivity(std::string_view field, char fallback) {
+
+		if(field.length() == 4 and strncasecmp(field.data(), "hico", 4) == 0)
+			return 'x';
+
+		if(field.length() == 4 and strncasecmp(field.data(), "loco", 4) == 0)
+			return 'y';
+
+		return fallback;
+	}
+
+	//
+	// one record per line: track1<TAB>track2[<TAB>track3[<TAB>hico|loco]],
+	// an empty field leaving that track alone; records without a
+	// coercivity use the fallback
+	//
+
+	bool plan::add(std::string_view line, char fallback) {
+
+		lines++;
+
+		if(not line.empty() and line.back() == '\r')
+			line.remove_suffix(1);
+
+		if(line.empty())
+			return false;
+
+		record r;
+
+		r.index = records.size();
+		r.line = lines;
+		r.coercivity = fallback;
+		r.tracks = 0;
+
+		for(int field = 0; field < 4; field++) {
+
+			size_t tab = line.find('\t');
+
+			std::string_view value = line.substr(0, tab);
+
+			if(field < 3) {
+				if(not value.empty() and value != track::empty) {
+					r.track[field] = value;
+					r.tracks |= 1 << field;
+				}
+			} else {
+				r.coercivity = coercivity(value, fallback);
+			}
+
+			if(tab == std::string_view::npos)
+				break;
+
+			line.remove_prefix(tab + 1);
+		}
+
+		if(r.tracks == 0)
+			return false;
+
+		input_order.push_back(r.coercivity);
+		records.push_back(std::move(r));
+
+		return true;
+	}
+
+	void plan::build() {
+
+		std::stable_sort(records.begin(), records.end(), [](const record& a, const record& b) {
+			return a.coercivity != b.coercivity ? a.coercivity < b.coercivity : a.tracks < b.tracks;
+		});
+
+		runs.clear();
+
+		for(size_t n = 0; n < records.size(); n++) {
+			if(runs.empty() or runs.back().coercivity != records[n].coercivity or runs.back().tracks != records[n].tracks)
+				runs.push_back({ n, 0, records[n].coercivity, records[n].tracks });
+			runs.back().count++;
+		}
+	}
+
+	unsigned long plan::switches() const {
+
+		unsigned long n = 0;
+
+		for(size_t r = 1; r < runs.size(); r++)
+			if(runs[r].coercivity != runs[r - 1].coercivity)
+				n++;
+
+		return n;
+	}
+
+	unsigned long plan::unplanned_switches() const {
+
+		unsigned long n = 0;
+
+		for(size_t r = 1; r < input_order.size(); r++)
+			if(input_order[r] != input_order[r - 1])
+				n++;
+
+		return n;
+	}
+}
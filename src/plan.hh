@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+namespace jank {
+
+	//
+	// reorders a whole job into runs of one coercivity and one set of
+	// tracks, so stock is swapped and the mode set once per run rather
+	// than whenever the input happens to change; index keeps each record's
+	// place among the records for reporting results in the original order,
+	// and line its line in the input, blank lines included
+	//
+
+	class plan {
+
+		public:
+
+			enum layout : uint8_t { track1 = 1, track2 = 2, track3 = 4 };
+
+			struct record {
+				uint32_t index;
+				uint32_t line;
+				char coercivity;
+				uint8_t tracks;
+				std::string track[3];
+			};
+
+			struct run {
+				size_t first;
+				size_t count;
+				char coercivity;
+				uint8_t tracks;
+			};
+
+			std::vector<record> records;
+			std::vector<run> runs;
+
+			uint32_t lines;
+
+			bool add(std::string_view, char);
+			void build();
+
+			unsigned long switches() const;
+			unsigned long unplanned_switches() const;
+
+			static char coercivity(std::string_view, char);
+
+			plan();
+
+		private:
+
+			std::vector<char> input_order;
+	};
+}
@@ -0,0 +1,268 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <jank.hh>
+#include <format.hh>
+#include <archive.hh>
+#include <reformat.hh>
+
+namespace jank {
+
+	reformat::reformat(const char *fmts) : threads(0), chunk(default_chunk), records(0), chunks(0), program(fmts) {
+	}
+
+	//
+	// one record per line, either "track1<TAB>track2" as used by T12 and
+	// T1T2 or a single track; a lone track starting with '%' is track1
+	//
+
+	void reformat::split(std::string_view text, std::vector<record>& out) {
+
+		while(not text.empty()) {
+
+			size_t eol = text.find('\n');
+
+			std::string_view line = text.substr(0, eol);
+
+			text.remove_prefix(eol == std::string_view::npos ? text.length() : eol + 1);
+
+			if(not line.empty() and line.back() == '\r')
+				line.remove_suffix(1);
+
+			if(line.empty())
+				continue;
+
+			size_t tab = line.find('\t');
+
+			if(tab != std::string_view::npos)
+				out.push_back({ line.substr(0, tab), line.substr(tab + 1) });
+			else if(line.front() == '%')
+				out.push_back({ line, track::empty });
+			else
+				out.push_back({ track::empty, line });
+		}
+	}
+
+	bool reformat::emit(int fd, const std::string& s) {
+
+		size_t done = 0;
+
+		while(done < s.length()) {
+
+			ssize_t n = ::write(fd, s.data() + done, s.length() - done);
+
+			if(n == -1) {
+				if(errno == EINTR)
+					continue;
+				return false;
+			}
+
+			done += n;
+		}
+
+		return true;
+	}
+
+	bool reformat::run(const std::vector<record>& input, int fd) {
+
+		unsigned int nthreads = threads ? threads : std::max(1U, std::thread::hardware_concurrency());
+
+		size_t per = std::max((size_t)1, chunk);
+		size_t total = (input.size() + per - 1) / per;
+
+		//
+		// workers claim chunks in order and may run at most a window of
+		// chunks ahead of the writer, which bounds buffered output
+		//
+
+		size_t window = 2 * nthreads;
+
+		std::vector<std::string> done(total);
+		std::vector<bool> ready(total, false);
+
+		std::mutex lock;
+		std::condition_variable cv;
+
+		size_t next = 0;
+		size_t written = 0;
+		bool failed = false;
+
+		auto worker = [&] {
+
+			std::string line;
+
+			for(;;) {
+
+				size_t c;
+
+				{
+					std::unique_lock guard(lock);
+					cv.wait(guard, [&] { return failed or next >= total or next < written + window; });
+					if(failed or next >= total)
+						return;
+					c = next++;
+				}
+
+				std::string out;
+
+				size_t last = std::min(input.size(), (c + 1) * per);
+
+				for(size_t n = c * per; n < last; n++) {
+					program.apply(input[n].track1, input[n].track2, line);
+					out.append(line);
+					out.push_back('\n');
+				}
+
+				{
+					std::lock_guard guard(lock);
+					done[c].swap(out);
+					ready[c] = true;
+				}
+
+				cv.notify_all();
+			}
+		};
+
+		std::vector<std::thread> pool;
+
+		for(unsigned int n = 0; n < std::min((size_t)nthreads, total); n++)
+			pool.emplace_back(worker);
+
+		for(size_t c = 0; c < total; c++) {
+
+			std::string out;
+
+			{
+				std::unique_lock guard(lock);
+				cv.wait(guard, [&] { return ready[c]; });
+				done[c].swap(out);
+			}
+
+			bool ok = emit(fd, out);
+
+			{
+				std::lock_guard guard(lock);
+				written = c + 1;
+				failed = not ok;
+			}
+
+			cv.notify_all();
+
+			if(not ok)
+				break;
+		}
+
+		int e = errno;
+
+		for(auto& t : pool)
+			t.join();
+
+		records += failed ? 0 : input.size();
+		chunks += failed ? 0 : total;
+
+		errno = e;
+
+		return not failed;
+	}
+
+	bool reformat::run(const char *path, int fd) {
+
+		std::vector<record> input;
+
+		archive::reader columns;
+
+		if(strcmp(path, "-") == 0) {
+
+			std::string text;
+			char buf[65536];
+			ssize_t n;
+
+			while((n = ::read(STDIN_FILENO, buf, sizeof(buf))) != 0) {
+				if(n == -1) {
+					if(errno == EINTR)
+						continue;
+					return false;
+				}
+				text.append(buf, n);
+			}
+
+			split(text, input);
+
+			return run(input, fd);
+		}
+
+		if(columns.open(path)) {
+
+			input.reserve(columns.rows());
+
+			for(size_t b = 0; b < columns.blocks(); b++) {
+
+				auto k = columns.get(b);
+
+				for(size_t r = 0; r < k.rows; r++) {
+
+					auto status = [&](int no) { return k.status[no][r] == (uint8_t)archive::state::error ? std::string_view(track::error) : std::string_view(track::empty); };
+
+					input.push_back({
+						k.status[0][r] == (uint8_t)archive::state::ok ? k.track(r, 0) : status(0),
+						k.status[1][r] == (uint8_t)archive::state::ok ? k.track(r, 1) : status(1)
+					});
+				}
+			}
+
+			return run(input, fd);
+		}
+
+		if(errno != EPROTO)
+			return false;
+
+		struct stat sb;
+
+		int in = ::open(path, O_RDONLY);
+		if(in == -1)
+			return false;
+
+		if(fstat(in, &sb) == -1) {
+			int e = errno;
+			::close(in);
+			errno = e;
+			return false;
+		}
+
+		if(sb.st_size == 0) {
+			::close(in);
+			return true;
+		}
+
+		void *p = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, in, 0);
+
+		::close(in);
+
+		if(p == MAP_FAILED)
+			return false;
+
+		madvise(p, sb.st_size, MADV_SEQUENTIAL);
+
+		split(std::string_view((const char *)p, sb.st_size), input);
+
+		bool success = run(input, fd);
+
+		int e = errno;
+		munmap(p, sb.st_size);
+		errno = e;
+
+		return success;
+	}
+}
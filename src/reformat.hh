@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <format.hh>
+
+namespace jank {
+
+	//
+	// applies a format program to every stored track1/track2 pair in a
+	// text file or an archive, formatting chunks on a pool of threads and
+	// writing the results in input order
+	//
+
+	class reformat {
+
+		public:
+
+			struct record {
+				std::string_view track1;
+				std::string_view track2;
+			};
+
+			constexpr static size_t default_chunk = 16384;
+
+			unsigned int threads;
+			size_t chunk;
+
+			unsigned long records;
+			unsigned long chunks;
+
+			static void split(std::string_view, std::vector<record>&);
+
+			bool run(const char *, int);
+			bool run(const std::vector<record>&, int);
+
+			reformat(const char *);
+
+		private:
+
+			format_program program;
+
+			bool emit(int, const std::string&);
+	};
+}
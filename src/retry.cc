@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+
+#include <cerrno>
+
+#include <retry.hh>
+
+namespace jank {
+
+	double retry_policy::counters::yield() const {
+		unsigned long writes = first_pass + recovered + skipped + stopped;
+		return writes > 0 ? (double)(first_pass + recovered) / writes : 0;
+	}
+
+	void retry_policy::counters::clear() {
+		std::fill(std::begin(failures), std::end(failures), 0);
+		first_pass = recovered = retries = skipped = stopped = waited_ms = 0;
+	}
+
+	//
+	// swipes and timeouts only need the card fed again, media errors get a
+	// short backoff, format errors cannot be fixed by retrying and device
+	// faults stop the batch once a few slow retries have not helped; a card
+	// that fails verification is rewritten on the next one
+	//
+
+	retry_policy::retry_policy() : current(0), previous(failure::cancelled) {
+
+		rules[(size_t)failure::cancelled] = { 0, 0,    1, 0,    action::stop };
+		rules[(size_t)failure::swipe]     = { 5, 0,    1, 0,    action::skip };
+		rules[(size_t)failure::media]     = { 3, 250,  2, 1000, action::skip };
+		rules[(size_t)failure::format]    = { 0, 0,    1, 0,    action::skip };
+		rules[(size_t)failure::protocol]  = { 3, 100,  2, 800,  action::skip };
+		rules[(size_t)failure::timeout]   = { 3, 0,    1, 0,    action::stop };
+		rules[(size_t)failure::device]    = { 2, 1000, 2, 4000, action::stop };
+		rules[(size_t)failure::verify]    = { 2, 0,    1, 0,    action::skip };
+
+		std::fill(std::begin(attempt), std::end(attempt), 0);
+
+		st.clear();
+	}
+
+	retry_policy::failure retry_policy::classify(int msr_errno, int err) {
+
+		switch(err) {
+			case ECANCELED: return failure::cancelled;
+			case ETIME:     return failure::timeout;
+			case EPROTO:    return failure::protocol;
+			case EBADMSG:   return failure::verify;
+		}
+
+		switch(msr_errno) {
+			case 9: return failure::swipe;
+			case 1: return failure::media;
+			case 2:
+			case 4: return failure::format;
+		}
+
+		return failure::device;
+	}
+
+	const char *retry_policy::name(failure f) {
+		switch(f) {
+			case failure::cancelled: return "cancelled";
+			case failure::swipe:     return "swipe";
+			case failure::media:     return "media";
+			case failure::format:    return "format";
+			case failure::protocol:  return "protocol";
+			case failure::timeout:   return "timeout";
+			case failure::device:    return "device";
+			case failure::verify:    return "verify";
+			case failure::count:     break;
+		}
+		return "unknown";
+	}
+
+	//
+	// n identifies the record being written; a new n starts a fresh set of
+	// per-class attempt counts
+	//
+
+	retry_policy::action retry_policy::decide(int n, int msr_errno, int err, int& wait_ms) {
+
+		if(n != current) {
+			current = n;
+			std::fill(std::begin(attempt), std::end(attempt), 0);
+		}
+
+		failure f = classify(msr_errno, err);
+		const rule& r = rules[(size_t)f];
+
+		previous = f;
+
+		st.failures[(size_t)f]++;
+
+		int k = ++attempt[(size_t)f];
+
+		wait_ms = 0;
+
+		if(k > r.limit) {
+
+			current = 0;
+
+			if(r.exhausted == action::stop)
+				st.stopped++;
+			else
+				st.skipped++;
+
+			return r.exhausted;
+		}
+
+		wait_ms = std::min((double)r.max_ms, r.backoff_ms * std::pow(r.factor, k - 1));
+
+		st.retries++;
+		st.waited_ms += wait_ms;
+
+		return action::retry;
+	}
+
+	void retry_policy::success() {
+
+		if(current != 0)
+			st.recovered++;
+		else
+			st.first_pass++;
+
+		current = 0;
+	}
+
+	int retry_policy::tries() const {
+		return current ? attempt[(size_t)previous] : 0;
+	}
+
+	retry_policy::failure retry_policy::last() const {
+		return previous;
+	}
+}
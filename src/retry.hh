@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+namespace jank {
+
+	//
+	// unattended retry decisions: a failed write is classified from
+	// msr_errno and errno, and each class has its own retry limit, backoff
+	// and what to do once the limit is used up
+	//
+
+	class retry_policy {
+
+		public:
+
+			enum class failure : unsigned char { cancelled, swipe, media, format, protocol, timeout, device, verify, count };
+
+			enum class action : unsigned char { retry, skip, stop };
+
+			struct rule {
+				int limit;
+				int backoff_ms;
+				double factor;
+				int max_ms;
+				action exhausted;
+			};
+
+			struct counters {
+
+				unsigned long failures[(size_t)failure::count];
+
+				unsigned long first_pass;
+				unsigned long recovered;
+				unsigned long retries;
+				unsigned long skipped;
+				unsigned long stopped;
+
+				unsigned long waited_ms;
+
+				double yield() const;
+				void clear();
+			};
+
+			rule rules[(size_t)failure::count];
+
+			counters st;
+
+			static failure classify(int, int);
+			static const char *name(failure);
+
+			action decide(int, int, int, int&);
+			void success();
+
+			int tries() const;
+			failure last() const;
+
+			retry_policy();
+
+		private:
+
+			int current;
+			int attempt[(size_t)failure::count];
+			failure previous;
+	};
+}
@@ -0,0 +1,259 @@
+#include <string>
+#include <atomic>
+#include <algorithm>
+
+#include <cstring>
+#include <ctime>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <ring.hh>
+
+namespace jank {
+
+	static const char ring_magic[8] = { 'J', 'A', 'N', 'K', 'R', 'N', 'G', '2' };
+
+	ring::ring() : cursor(0), published(0), lost(0), fd(-1), head(nullptr), slots(nullptr), mapped(0) {
+	}
+
+	ring::~ring() {
+		close();
+	}
+
+	int64_t ring::now() {
+
+		timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+
+		return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+	}
+
+	//
+	// the producer side; capacity is rounded up to a power of two
+	//
+
+	bool ring::create(const char *path, size_t capacity) {
+
+		if(head != nullptr) {
+			errno = EALREADY;
+			return false;
+		}
+
+		size_t n = 1;
+
+		while(n < capacity)
+			n <<= 1;
+
+		size_t bytes = sizeof(header) + n * sizeof(slot);
+
+		//
+		// a new file rather than truncating, so readers still mapping an
+		// old ring never fault on it
+		//
+
+		unlink(path);
+
+		fd = ::open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if(fd == -1)
+			return false;
+
+		if(ftruncate(fd, bytes) == -1)
+			goto failure;
+
+		{
+			void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+			if(p == MAP_FAILED)
+				goto failure;
+
+			head = (header *)p;
+			slots = (slot *)(head + 1);
+			mapped = bytes;
+		}
+
+		head->capacity = n;
+		head->slot_size = sizeof(slot);
+		head->head = 0;
+
+		std::atomic_thread_fence(std::memory_order_release);
+
+		memcpy(head->magic, ring_magic, sizeof(ring_magic));
+
+		return true;
+
+	failure:
+		int e = errno;
+		close();
+		errno = e;
+		return false;
+	}
+
+	//
+	// the consumer side, mapped read-only and starting at the newest event
+	//
+
+	bool ring::open(const char *path) {
+
+		struct stat sb;
+
+		if(head != nullptr) {
+			errno = EALREADY;
+			return false;
+		}
+
+		fd = ::open(path, O_RDONLY);
+		if(fd == -1)
+			return false;
+
+		if(fstat(fd, &sb) == -1)
+			goto failure;
+
+		if((size_t)sb.st_size < sizeof(header)) {
+			errno = EPROTO;
+			goto failure;
+		}
+
+		{
+			void *p = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+			if(p == MAP_FAILED)
+				goto failure;
+
+			head = (header *)p;
+			slots = (slot *)(head + 1);
+			mapped = sb.st_size;
+		}
+
+		if(memcmp(head->magic, ring_magic, sizeof(ring_magic)) != 0 or head->slot_size != sizeof(slot) or sizeof(header) + head->capacity * sizeof(slot) != mapped) {
+			errno = EPROTO;
+			goto failure;
+		}
+
+		cursor = std::atomic_ref<uint64_t>(head->head).load(std::memory_order_acquire);
+
+		return true;
+
+	failure:
+		int e = errno;
+		close();
+		errno = e;
+		return false;
+	}
+
+	bool ring::close() {
+
+		if(head != nullptr)
+			munmap(head, mapped);
+
+		if(fd != -1)
+			::close(fd);
+
+		bool was_open = head != nullptr;
+
+		fd = -1;
+		head = nullptr;
+		slots = nullptr;
+		mapped = 0;
+
+		return was_open;
+	}
+
+	bool ring::publish(kind what, uint32_t n, bool ok, int msr_errno, int error, const std::string& t1, const std::string& t2, const std::string& t3) {
+
+		if(head == nullptr) {
+			errno = ENOMEDIUM;
+			return false;
+		}
+
+		const std::string *tracks[] = { &t1, &t2, &t3 };
+
+		std::atomic_ref<uint64_t> top(head->head);
+
+		uint64_t seq = top.load(std::memory_order_relaxed);
+
+		slot& s = slots[seq & (head->capacity - 1)];
+
+		std::atomic_ref<uint64_t> version(s.version);
+
+		version.store(2 * seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		s.ev.seq = seq;
+		s.ev.time_ns = now();
+		s.ev.n = n;
+		s.ev.what = what;
+		s.ev.ok = ok;
+		s.ev.msr_errno = msr_errno;
+		s.ev.error = error;
+
+		//
+		// a track longer than a slot holds is cut, with its full length
+		// kept beside it so readers know the data is incomplete
+		//
+
+		for(int t = 0; t < 3; t++) {
+			s.ev.length[t] = std::min(tracks[t]->length(), track_max);
+			s.ev.full_length[t] = std::min(tracks[t]->length(), (size_t)UINT16_MAX);
+			memcpy(s.ev.track[t], tracks[t]->data(), s.ev.length[t]);
+		}
+
+		version.store(2 * seq + 2, std::memory_order_release);
+		top.store(seq + 1, std::memory_order_release);
+
+		published++;
+
+		return true;
+	}
+
+	//
+	// 1 with the next event, 0 when there is none yet, or -1 when the
+	// producer has lapped this reader, which then skips ahead to the
+	// oldest event still in the ring and counts what it missed
+	//
+
+	int ring::next(event& ev) {
+
+		if(head == nullptr) {
+			errno = ENOMEDIUM;
+			return -1;
+		}
+
+		uint64_t top = std::atomic_ref<uint64_t>(head->head).load(std::memory_order_acquire);
+
+		if(cursor >= top)
+			return 0;
+
+		if(top - cursor > head->capacity) {
+			lost += top - head->capacity - cursor;
+			cursor = top - head->capacity;
+			return -1;
+		}
+
+		const slot& s = slots[cursor & (head->capacity - 1)];
+
+		std::atomic_ref<uint64_t> version(const_cast<uint64_t&>(s.version));
+
+		uint64_t before = version.load(std::memory_order_acquire);
+
+		memcpy(&ev, &s.ev, sizeof(ev));
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		uint64_t after = version.load(std::memory_order_relaxed);
+
+		if(before != after or before != 2 * cursor + 2) {
+			lost++;
+			cursor++;
+			return -1;
+		}
+
+		cursor++;
+
+		return 1;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace jank {
+
+	//
+	// fixed-size swipe events in a shared-memory ring with one producer
+	// and any number of consumers; each slot carries a sequence word that
+	// is odd while the producer fills it, so a reader copies the slot out
+	// and keeps it only if the word is unchanged, and every reader keeps
+	// its own cursor so readers never write to the ring
+	//
+
+	class ring {
+
+		public:
+
+			enum class kind : uint8_t { read = 1, rawrd = 2, write = 3, erase = 4 };
+
+			constexpr static size_t track_max = 128;
+			constexpr static size_t default_capacity = 4096;
+
+			struct event {
+				uint64_t seq;
+				int64_t time_ns;
+				uint32_t n;
+				kind what;
+				uint8_t ok;
+				int16_t msr_errno;
+				int32_t error;
+				uint16_t length[3];
+				uint16_t full_length[3];
+				char track[3][track_max];
+			};
+
+			struct alignas(64) slot {
+				uint64_t version;
+				event ev;
+			};
+
+			struct alignas(64) header {
+				char magic[8];
+				uint32_t capacity;
+				uint32_t slot_size;
+				uint64_t head;
+			};
+
+			uint64_t cursor;
+
+			unsigned long published;
+			unsigned long lost;
+
+			bool create(const char *, size_t = default_capacity);
+			bool open(const char *);
+			bool close();
+
+			bool publish(kind, uint32_t, bool, int, int, const std::string&, const std::string&, const std::string&);
+
+			int next(event&);
+
+			static int64_t now();
+
+			ring();
+			~ring();
+
+		private:
+
+			int fd;
+
+			header *head;
+			slot *slots;
+
+			size_t mapped;
+	};
+}
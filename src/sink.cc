@@ -0,0 +1,286 @@
+#include <string>
+#include <chrono>
+
+#include <cstring>
+#include <cstdio>
+
+#include <unistd.h>
+
+#include <jank.hh>
+#include <sink.hh>
+#include <archive.hh>
+
+namespace jank {
+
+	sink::sink(int my_fd, format my_fmt) : fmt(my_fmt), fd(my_fd), flush_every(1), capacity(default_capacity), records(0), writes(0), unflushed(0), header(false) {
+		if(fmt == format::archive) {
+			flush_every = 0;
+			columns = std::make_unique<archive::writer>();
+			columns->open(fd);
+		} else {
+			buffer.reserve(capacity);
+		}
+	}
+
+	sink::~sink() {
+		if(columns)
+			columns->close();
+		else
+			flush();
+	}
+
+	bool sink::parse_format(const char *s, format& f) {
+		if(strcasecmp(s, "jsonl") == 0 or strcasecmp(s, "json") == 0)
+			f = format::jsonl;
+		else if(strcasecmp(s, "csv") == 0)
+			f = format::csv;
+		else if(strcasecmp(s, "bin") == 0 or strcasecmp(s, "binary") == 0)
+			f = format::binary;
+		else if(strcasecmp(s, "archive") == 0 or strcasecmp(s, "jka") == 0)
+			f = format::archive;
+		else
+			return false;
+		return true;
+	}
+
+	bool sink::put(const record& r) {
+
+		switch(fmt) {
+			case format::jsonl:  encode_jsonl(r);  break;
+			case format::csv:    encode_csv(r);    break;
+			case format::binary: encode_binary(r); break;
+			case format::archive:
+				if(not columns->put(r))
+					return false;
+				break;
+		}
+
+		records++;
+		unflushed++;
+
+		if(buffer.length() >= capacity or (flush_every > 0 and unflushed >= flush_every))
+			return flush();
+
+		return true;
+	}
+
+	bool sink::flush() {
+
+		size_t done = 0;
+
+		if(columns) {
+			unflushed = 0;
+			return columns->flush();
+		}
+
+		while(done < buffer.length()) {
+
+			ssize_t n = ::write(fd, buffer.data() + done, buffer.length() - done);
+
+			if(n == -1) {
+				if(errno == EINTR)
+					continue;
+				buffer.erase(0, done);
+				return false;
+			}
+
+			done += n;
+			writes++;
+		}
+
+		buffer.clear();
+		unflushed = 0;
+
+		return true;
+	}
+
+	template <class T> void sink::le(T v) {
+		for(size_t i = 0; i < sizeof(T); i++)
+			buffer.push_back((char)((v >> (8 * i)) & 0xff));
+	}
+
+	void sink::hex(const std::string& s) {
+		const char digits[] = "0123456789abcdef";
+		for(unsigned char c : s) {
+			buffer.push_back(digits[c >> 4]);
+			buffer.push_back(digits[c & 15]);
+		}
+	}
+
+	void sink::json_string(const std::string& s) {
+
+		const char digits[] = "0123456789abcdef";
+
+		buffer.push_back('"');
+
+		for(unsigned char c : s) {
+			if(c == '"' or c == '\\') {
+				buffer.push_back('\\');
+				buffer.push_back(c);
+			} else if(c < 0x20 or c >= 0x7f) {
+				buffer.append("\\u00");
+				buffer.push_back(digits[c >> 4]);
+				buffer.push_back(digits[c & 15]);
+			} else {
+				buffer.push_back(c);
+			}
+		}
+
+		buffer.push_back('"');
+	}
+
+	void sink::csv_field(const std::string& s) {
+
+		if(s.find_first_of(",\"\r\n") == std::string::npos) {
+			buffer.append(s);
+			return;
+		}
+
+		buffer.push_back('"');
+
+		for(char c : s) {
+			if(c == '"')
+				buffer.push_back('"');
+			buffer.push_back(c);
+		}
+
+		buffer.push_back('"');
+	}
+
+	//
+	// raw reads leave unseen tracks empty rather than marking them
+	//
+
+	static int state(const std::string& t) {
+		return t.empty() or t == track::empty ? 1 : t == track::error ? 2 : 0;
+	}
+
+	static const char *state_name(int s) {
+		return s == 0 ? "OK" : s == 1 ? "EMPTY" : "ERROR";
+	}
+
+	static long long microseconds(const std::chrono::system_clock::time_point& t) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+	}
+
+	void sink::encode_jsonl(const record& r) {
+
+		char num[64];
+
+		snprintf(num, sizeof(num), "{\"seq\":%lu,\"time_us\":%lld,\"device\":", r.seq, microseconds(r.time));
+		buffer.append(num);
+
+		json_string(r.device ? *r.device : "");
+
+		buffer.append(r.what == op::read ? ",\"op\":\"read\"" : ",\"op\":\"rawrd\"");
+		buffer.append(r.ok ? ",\"ok\":true" : ",\"ok\":false");
+
+		snprintf(num, sizeof(num), ",\"msr_errno\":%d,\"tracks\":[", r.msr_errno);
+		buffer.append(num);
+
+		for(int no = 0; no < 3; no++) {
+
+			const std::string& t = *r.tracks[no];
+
+			buffer.append(no ? ",{\"status\":\"" : "{\"status\":\"");
+			buffer.append(state_name(state(t)));
+			buffer.append("\",\"data\":");
+
+			if(state(t) != 0) {
+				buffer.append("\"\"");
+			} else if(r.what == op::rawrd) {
+				buffer.push_back('"');
+				hex(t);
+				buffer.push_back('"');
+			} else {
+				json_string(t);
+			}
+
+			buffer.push_back('}');
+		}
+
+		buffer.append("]}\n");
+	}
+
+	void sink::encode_csv(const record& r) {
+
+		char num[64];
+
+		if(not header) {
+			buffer.append("seq,time_us,device,op,ok,msr_errno,track1_status,track1,track2_status,track2,track3_status,track3\n");
+			header = true;
+		}
+
+		snprintf(num, sizeof(num), "%lu,%lld,", r.seq, microseconds(r.time));
+		buffer.append(num);
+
+		csv_field(r.device ? *r.device : "");
+
+		buffer.append(r.what == op::read ? ",read" : ",rawrd");
+		buffer.append(r.ok ? ",1" : ",0");
+
+		snprintf(num, sizeof(num), ",%d", r.msr_errno);
+		buffer.append(num);
+
+		for(int no = 0; no < 3; no++) {
+
+			const std::string& t = *r.tracks[no];
+
+			buffer.push_back(',');
+			buffer.append(state_name(state(t)));
+			buffer.push_back(',');
+
+			if(state(t) != 0)
+				continue;
+
+			if(r.what == op::rawrd)
+				hex(t);
+			else
+				csv_field(t);
+		}
+
+		buffer.push_back('\n');
+	}
+
+	//
+	// u32 length of the rest of the record, u64 seq, i64 time_us, u8 op,
+	// u8 ok, i8 msr_errno, u16 device length + device, then per track
+	// u8 status (0 ok, 1 empty, 2 error), u16 length + bytes; all little endian
+	//
+
+	void sink::encode_binary(const record& r) {
+
+		size_t start = buffer.length();
+
+		le<uint32_t>(0);
+
+		le<uint64_t>(r.seq);
+		le<int64_t>(microseconds(r.time));
+		le<uint8_t>((uint8_t)r.what);
+		le<uint8_t>(r.ok ? 1 : 0);
+		le<uint8_t>((uint8_t)r.msr_errno);
+
+		const std::string& device = r.device ? *r.device : "";
+
+		le<uint16_t>((uint16_t)std::min(device.length(), (size_t)0xffff));
+		buffer.append(device, 0, 0xffff);
+
+		for(int no = 0; no < 3; no++) {
+
+			const std::string& t = *r.tracks[no];
+
+			bool ok = state(t) == 0;
+
+			le<uint8_t>(state(t));
+			le<uint16_t>(ok ? (uint16_t)std::min(t.length(), (size_t)0xffff) : 0);
+
+			if(ok)
+				buffer.append(t, 0, 0xffff);
+		}
+
+		uint32_t len = buffer.length() - start - 4;
+
+		for(size_t i = 0; i < 4; i++)
+			buffer[start + i] = (char)((len >> (8 * i)) & 0xff);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <memory>
+
+namespace jank {
+
+	namespace archive {
+		class writer;
+	}
+
+	class sink {
+
+		public:
+
+			enum class format { jsonl, csv, binary, archive };
+
+			enum class op : unsigned char { read = 1, rawrd = 2 };
+
+			struct record {
+				unsigned long seq;
+				std::chrono::system_clock::time_point time;
+				const std::string *device;
+				op what;
+				bool ok;
+				int msr_errno;
+				const std::string *tracks[3];
+			};
+
+			constexpr static size_t default_capacity = 64 * 1024;
+
+			format fmt;
+
+			int fd;
+
+			unsigned int flush_every;
+
+			size_t capacity;
+
+			unsigned long records;
+			unsigned long writes;
+
+			static bool parse_format(const char *, format&);
+
+			bool put(const record&);
+			bool flush();
+
+			sink(int, format);
+			~sink();
+
+		private:
+
+			std::string buffer;
+
+			unsigned int unflushed;
+
+			bool header;
+
+			std::unique_ptr<archive::writer> columns;
+
+			void encode_jsonl(const record&);
+			void encode_csv(const record&);
+			void encode_binary(const record&);
+
+			void json_string(const std::string&);
+			void csv_field(const std::string&);
+			void hex(const std::string&);
+
+			template <class T> void le(T);
+	};
+}
@@ -0,0 +1,222 @@
+#include <string>
+#include <algorithm>
+
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <stream.hh>
+#include <transport.hh>
+
+namespace jank {
+
+	//
+	// a dup of the same descriptor (input "-" with stdin as the interrupt)
+	// counts as the same file
+	//
+
+	static bool same_file(int a, int b) {
+
+		struct stat sa, sb;
+
+		if(a == -1 or b == -1)
+			return false;
+
+		return a == b or (fstat(a, &sa) == 0 and fstat(b, &sb) == 0 and sa.st_dev == sb.st_dev and sa.st_ino == sb.st_ino);
+	}
+
+	line_reader::line_reader(int my_fd, int my_interrupt_fd) : fd(my_fd), interrupt_fd(my_interrupt_fd), offset(0), head(0), eof(false), interrupt_is_input(same_file(my_fd, my_interrupt_fd)) {
+	}
+
+	//
+	// waits for input on fd, or for a newline on interrupt_fd, then reads
+	// at most one block; when interrupt_fd is the input, draining it
+	// would swallow input, so only fd is polled
+	//
+
+	bool line_reader::fill() {
+
+		pollfd fds[2] = { { fd, POLLIN, 0 }, { interrupt_fd, POLLIN, 0 } };
+
+		bool interruptible = interrupt_fd != -1 and not interrupt_is_input;
+
+		for(;;) {
+
+			int n = poll(fds, interruptible ? 2 : 1, -1);
+
+			if(n == -1) {
+				if(errno == EINTR)
+					continue;
+				return false;
+			}
+
+			if(interruptible and (fds[1].revents & POLLIN)) {
+
+				char buf[256];
+
+				ssize_t k = ::read(interrupt_fd, buf, sizeof(buf));
+
+				if(k > 0 and memchr(buf, '\n', k) != nullptr) {
+					errno = ECANCELED;
+					return false;
+				}
+			}
+
+			if(fds[0].revents != 0)
+				break;
+		}
+
+		if(head > 0) {
+			buffer.erase(0, head);
+			head = 0;
+		}
+
+		size_t at = buffer.length();
+
+		buffer.resize(at + block_size);
+
+		ssize_t n;
+
+		while((n = ::read(fd, buffer.data() + at, block_size)) == -1 and errno == EINTR);
+
+		buffer.resize(at + std::max((ssize_t)0, n));
+
+		if(n == 0)
+			eof = true;
+
+		return n != -1;
+	}
+
+	bool line_reader::next(std::string_view& line) {
+
+		for(;;) {
+
+			size_t eol = buffer.find('\n', head);
+
+			if(eol != std::string::npos) {
+				line = std::string_view(buffer).substr(head, eol - head);
+				offset += eol + 1 - head;
+				head = eol + 1;
+				return true;
+			}
+
+			if(eof) {
+
+				errno = 0;
+
+				if(head == buffer.length())
+					return false;
+
+				line = std::string_view(buffer).substr(head);
+				offset += buffer.length() - head;
+				head = buffer.length();
+
+				return true;
+			}
+
+			if(not fill())
+				return false;
+		}
+	}
+
+	int line_reader::skip(int count) {
+
+		std::string_view line;
+
+		int n = 0;
+
+		while(n < count and next(line))
+			n++;
+
+		return n;
+	}
+
+	bool line_reader::seekable() const {
+		struct stat sb;
+		return fstat(fd, &sb) == 0 and S_ISREG(sb.st_mode);
+	}
+
+	bool line_reader::seek(uint64_t to) {
+
+		if(lseek(fd, to, SEEK_SET) == -1)
+			return false;
+
+		buffer.clear();
+		head = 0;
+		eof = false;
+		offset = to;
+
+		return true;
+	}
+
+	//
+	// "-" is stdin, "unix:path" and "tcp:host:port" connect to a producer,
+	// anything else is opened as a file or FIFO
+	//
+
+	int open_input(const char *spec) {
+
+		if(strcmp(spec, "-") == 0)
+			return dup(STDIN_FILENO);
+
+		if(strncmp(spec, "unix:", 5) == 0) {
+
+			sockaddr_un sa;
+
+			memset(&sa, 0, sizeof(sa));
+			sa.sun_family = AF_UNIX;
+
+			if(strlen(spec + 5) >= sizeof(sa.sun_path)) {
+				errno = ENAMETOOLONG;
+				return -1;
+			}
+
+			strcpy(sa.sun_path, spec + 5);
+
+			int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if(fd == -1)
+				return -1;
+
+			if(connect(fd, (sockaddr *)&sa, sizeof(sa)) == -1) {
+				int e = errno;
+				::close(fd);
+				errno = e;
+				return -1;
+			}
+
+			shutdown(fd, SHUT_WR);
+
+			return fd;
+		}
+
+		if(strncmp(spec, "tcp:", 4) == 0) {
+
+			std::string host(spec + 4);
+
+			auto colon = host.rfind(':');
+			if(colon == std::string::npos) {
+				errno = EINVAL;
+				return -1;
+			}
+
+			std::string port = host.substr(colon + 1);
+			host.resize(colon);
+
+			int fd = tcp_transport::connect(host.c_str(), port.c_str());
+
+			if(fd != -1)
+				shutdown(fd, SHUT_WR);
+
+			return fd;
+		}
+
+		return open(spec, O_RDONLY | O_CLOEXEC);
+	}
+}
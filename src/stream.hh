@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <cstdint>
+
+namespace jank {
+
+	//
+	// reads batch input a line at a time from a file, FIFO or socket,
+	// pulling only what the next line needs so a producer writing into a
+	// pipe is held back by the pipe itself; a newline on the interrupt
+	// descriptor stops a wait for input, unless that descriptor is the
+	// input itself, which is then left alone
+	//
+
+	class line_reader {
+
+		public:
+
+			constexpr static size_t block_size = 64 * 1024;
+
+			int fd;
+			int interrupt_fd;
+
+			uint64_t offset;
+
+			bool next(std::string_view&);
+			int skip(int);
+
+			bool seekable() const;
+			bool seek(uint64_t);
+
+			line_reader(int, int = -1);
+
+		private:
+
+			std::string buffer;
+			size_t head;
+			bool eof;
+			bool interrupt_is_input;
+
+			bool fill();
+	};
+
+	int open_input(const char *);
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#include <unistd.h>
+#include <signal.h>
+
+#include <ring.hh>
+
+namespace config {
+
+	bool follow = true;
+	bool all = false;
+	long poll_us = 100;
+	const char *filename = nullptr;
+
+	int argc;
+	char **argv;
+
+	void usage() {
+
+		std::string prog = basename(argv[0]);
+
+		std::cout << std::endl << "usage: " << prog << " [options] ring" << std::endl << std::endl;
+
+		std::cout << "\t-h          show this help" << std::endl;
+		std::cout << "\t-a          start at the oldest event still in the ring instead of the newest" << std::endl;
+		std::cout << "\t-n          print what is there and exit instead of following" << std::endl;
+		std::cout << "\t-p usec     poll interval while following (default=" << poll_us << ")" << std::endl;
+
+		std::cout << std::endl;
+	}
+
+	void init(int my_argc, char **my_argv) {
+
+		argc = my_argc;
+		argv = my_argv;
+	}
+
+	bool parse() {
+
+		int opt;
+
+		while((opt = getopt(argc, argv, "hanp:")) != -1) {
+
+			switch(opt) {
+
+				case 'a': all    = not all   ; break;
+				case 'n': follow = not follow; break;
+				case 'p': poll_us = std::max(1L, atol(optarg)); break;
+
+				case 'h':
+				default:
+						  return false;
+			}
+		}
+
+		if(optind >= argc)
+			return false;
+
+		filename = argv[optind++];
+
+		return true;
+	}
+}
+
+volatile sig_atomic_t done = false;
+
+void signal_handler(int) {
+	done = true;
+}
+
+//
+// one line per event: seq, time, record, kind, status, msr_errno, errno,
+// microseconds from publish to here, then the three tracks; a track the
+// ring cut short ends in \...(n) with its full length n
+//
+
+void print(const jank::ring::event& ev) {
+
+	static const char *kinds[] = { "?", "read", "rawrd", "write", "erase" };
+
+	printf("%lu\t%ld.%09ld\t%u\t%s\t%s\t%d\t%d\t%.1f", (unsigned long)ev.seq, (long)(ev.time_ns / 1000000000), (long)(ev.time_ns % 1000000000), ev.n,
+		kinds[(size_t)ev.what < 5 ? (size_t)ev.what : 0], ev.ok ? "OK" : "FAILED", ev.msr_errno, ev.error, (jank::ring::now() - ev.time_ns) / 1000.0);
+
+	for(int t = 0; t < 3; t++) {
+
+		putchar('\t');
+
+		for(size_t k = 0; k < ev.length[t]; k++) {
+			unsigned char c = ev.track[t][k];
+			if(isprint(c) and c != '\\')
+				putchar(c);
+			else
+				printf("\\x%02x", c);
+		}
+
+		if(ev.full_length[t] > ev.length[t])
+			printf("\\...(%u)", ev.full_length[t]);
+	}
+
+	putchar('\n');
+}
+
+int main(int argc, char **argv) {
+
+	jank::ring events;
+
+	jank::ring::event ev;
+
+	config::init(argc, argv);
+
+	if(not config::parse()) {
+		config::usage();
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	if(not events.open(config::filename)) {
+		perror(config::filename);
+		return EXIT_FAILURE;
+	}
+
+	if(config::all)
+		events.cursor = 0;
+
+	while(not done) {
+
+		int r = events.next(ev);
+
+		if(r == 1) {
+			print(ev);
+			fflush(stdout);
+		} else if(r == 0) {
+			if(not config::follow)
+				break;
+			usleep(config::poll_us);
+		}
+	}
+
+	if(events.lost > 0)
+		fprintf(stderr, "lost=%lu\n", events.lost);
+
+	return EXIT_SUCCESS;
+}
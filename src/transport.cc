@@ -0,0 +1,420 @@
+#include <string>
+#include <algorithm>
+
+#include <cstring>
+#include <cerrno>
+
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <climits>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <linux/serial.h>
+
+#include <transport.hh>
+
+namespace jank {
+
+	transport::~transport() {
+	}
+
+	bool transport::configure(long, bool) {
+		return true;
+	}
+
+	bool transport::serial() const {
+		return false;
+	}
+
+	bool transport::reopen() {
+		errno = ENOTSUP;
+		return false;
+	}
+
+	std::unique_ptr<transport> transport::open(const char *spec) {
+
+		if(strncmp(spec, "tcp:", 4) == 0) {
+
+			std::string host(spec + 4);
+
+			auto colon = host.rfind(':');
+			if(colon == std::string::npos) {
+				errno = EINVAL;
+				return nullptr;
+			}
+
+			std::string port = host.substr(colon + 1);
+			host.resize(colon);
+
+			int fd = tcp_transport::connect(host.c_str(), port.c_str());
+			if(fd == -1)
+				return nullptr;
+
+			return std::make_unique<tcp_transport>(fd, host, port);
+		}
+
+		std::string path = fd_transport::identify(spec);
+
+		int fd = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+		if(fd == -1)
+			return nullptr;
+
+		return std::make_unique<fd_transport>(fd, path);
+	}
+
+	fd_transport::fd_transport(int my_fd, const std::string& my_path) : descriptor(my_fd), path(my_path), baud(9600), low_latency(false), serial_flags(-1) {
+	}
+
+	//
+	// the /dev/serial/by-id name of a device follows the adapter across
+	// re-enumeration, where ttyUSBn and links made to it may not
+	//
+
+	std::string fd_transport::identify(const char *spec) {
+
+		const std::string by_id = "/dev/serial/by-id/";
+
+		char *real = realpath(spec, nullptr);
+
+		if(real == nullptr)
+			return spec;
+
+		std::string target(real);
+
+		free(real);
+
+		if(DIR *dir = opendir(by_id.c_str())) {
+
+			while(dirent *de = readdir(dir)) {
+
+				if(de->d_name[0] == '.')
+					continue;
+
+				std::string candidate = by_id + de->d_name;
+
+				if(char *p = realpath(candidate.c_str(), nullptr)) {
+
+					bool same = (target == p);
+
+					free(p);
+
+					if(same) {
+						closedir(dir);
+						return candidate;
+					}
+				}
+			}
+
+			closedir(dir);
+		}
+
+		return spec;
+	}
+
+	bool fd_transport::reopen() {
+
+		if(path.empty()) {
+			errno = ENOTSUP;
+			return false;
+		}
+
+		if(descriptor != -1)
+			::close(descriptor);
+
+		serial_flags = -1;
+
+		descriptor = ::open(path.c_str(), O_RDWR | O_NOCTTY);
+		if(descriptor == -1)
+			return false;
+
+		return configure(baud, low_latency);
+	}
+
+	fd_transport::~fd_transport() {
+
+		if(serial_flags != -1) {
+
+			serial_struct ss;
+
+			if(ioctl(descriptor, TIOCGSERIAL, &ss) == 0) {
+				ss.flags = serial_flags;
+				ioctl(descriptor, TIOCSSERIAL, &ss);
+			}
+		}
+
+		if(descriptor != -1)
+			::close(descriptor);
+	}
+
+	int fd_transport::release() {
+
+		int fd = descriptor;
+
+		descriptor = -1;
+		serial_flags = -1;
+
+		return fd;
+	}
+
+	int fd_transport::fd() const {
+		return descriptor;
+	}
+
+	ssize_t fd_transport::read(void *buf, size_t sz) {
+		return ::read(descriptor, buf, sz);
+	}
+
+	ssize_t fd_transport::write(const void *buf, size_t sz) {
+		return ::write(descriptor, buf, sz);
+	}
+
+	bool fd_transport::serial() const {
+		return isatty(descriptor);
+	}
+
+	speed_t fd_transport::speed(long rate) {
+		switch(rate) {
+			case 9600: return B9600;
+			case 19200: return B19200;
+			case 38400: return B38400;
+			case 57600: return B57600;
+			case 115200: return B115200;
+			case 230400: return B230400;
+		}
+		return B0;
+	}
+
+	bool fd_transport::configure(long my_baud, bool my_low_latency) {
+
+		termios options;
+
+		baud = my_baud;
+		low_latency = my_low_latency;
+
+		if(not isatty(descriptor))
+			return true;
+
+		if(speed(baud) == B0) {
+			errno = EINVAL;
+			return false;
+		}
+
+		if(tcgetattr(descriptor, &options) == -1)
+			return false;
+
+		if(cfsetispeed(&options, 0) == -1)
+			return false;
+		if(cfsetospeed(&options, speed(baud)) == -1)
+			return false;
+
+		options.c_cflag |= (CLOCAL | CREAD);
+
+		options.c_cflag &= ~PARENB;
+		options.c_cflag &= ~CSTOPB;
+		options.c_cflag &= ~CSIZE;
+		options.c_cflag |= CS8;
+
+		options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+
+		options.c_cc[VMIN]  = 1;
+		options.c_cc[VTIME] = 0;
+
+		options.c_oflag &= ~OPOST;
+
+		if(tcsetattr(descriptor, TCSADRAIN, &options) == -1)
+			return false;
+
+		//
+		// USB serial drivers hold received bytes for a latency timer
+		// (16ms on FTDI) unless told otherwise; drivers without the
+		// ioctl are left as they are
+		//
+
+		serial_struct ss;
+
+		if(low_latency and serial_flags == -1 and ioctl(descriptor, TIOCGSERIAL, &ss) == 0) {
+			serial_flags = ss.flags;
+			ss.flags |= ASYNC_LOW_LATENCY;
+			if(ioctl(descriptor, TIOCSSERIAL, &ss) == -1)
+				serial_flags = -1;
+		}
+
+		return true;
+	}
+
+	bool fd_transport::discard() {
+
+		if(isatty(descriptor))
+			return tcflush(descriptor, TCIOFLUSH) == 0;
+
+		char block[4096];
+
+		pollfd pfd = { descriptor, POLLIN, 0 };
+
+		while(poll(&pfd, 1, 0) == 1 and (pfd.revents & POLLIN))
+			if(::read(descriptor, block, sizeof(block)) <= 0)
+				break;
+
+		return true;
+	}
+
+	tcp_transport::tcp_transport(int my_fd, const std::string& my_host, const std::string& my_port) : fd_transport(my_fd), host(my_host), port(my_port) {
+	}
+
+	bool tcp_transport::reopen() {
+
+		if(descriptor != -1)
+			::close(descriptor);
+
+		descriptor = connect(host.c_str(), port.c_str());
+		if(descriptor == -1)
+			return false;
+
+		return configure(baud, low_latency);
+	}
+
+	int tcp_transport::connect(const char *host, const char *port) {
+
+		addrinfo hints, *res;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		if(getaddrinfo(host, port, &hints, &res) != 0) {
+			errno = EHOSTUNREACH;
+			return -1;
+		}
+
+		int fd = -1;
+
+		for(addrinfo *ai = res; ai != nullptr and fd == -1; ai = ai->ai_next) {
+
+			fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+			if(fd == -1)
+				continue;
+
+			if(::connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+				int e = errno;
+				::close(fd);
+				errno = e;
+				fd = -1;
+			}
+		}
+
+		freeaddrinfo(res);
+
+		return fd;
+	}
+
+	bool tcp_transport::configure(long my_baud, bool my_low_latency) {
+
+		int one = 1;
+
+		baud = my_baud;
+		low_latency = my_low_latency;
+
+		return setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0;
+	}
+
+	loopback::loopback() : rx_head(0), tx_head(0) {
+		event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+
+	loopback::~loopback() {
+		if(event_fd != -1)
+			::close(event_fd);
+	}
+
+	int loopback::fd() const {
+		return event_fd;
+	}
+
+	ssize_t loopback::read(void *buf, size_t sz) {
+
+		std::lock_guard guard(lock);
+
+		size_t n = std::min(sz, rx.length() - rx_head);
+
+		memcpy(buf, rx.data() + rx_head, n);
+
+		rx_head += n;
+
+		if(rx_head == rx.length()) {
+
+			uint64_t count;
+
+			rx.clear();
+			rx_head = 0;
+
+			::read(event_fd, &count, sizeof(count));
+		}
+
+		return n;
+	}
+
+	ssize_t loopback::write(const void *buf, size_t sz) {
+
+		std::lock_guard guard(lock);
+
+		tx.append((const char *)buf, sz);
+
+		return sz;
+	}
+
+	bool loopback::discard() {
+
+		std::lock_guard guard(lock);
+
+		uint64_t count;
+
+		rx.clear();
+		rx_head = 0;
+
+		::read(event_fd, &count, sizeof(count));
+
+		return true;
+	}
+
+	void loopback::feed(std::string_view s) {
+
+		std::lock_guard guard(lock);
+
+		uint64_t one = 1;
+
+		rx.append(s);
+
+		::write(event_fd, &one, sizeof(one));
+	}
+
+	//
+	// the view stays valid until the next write or consume
+	//
+
+	std::string_view loopback::sent() const {
+
+		std::lock_guard guard(lock);
+
+		return std::string_view(tx).substr(tx_head);
+	}
+
+	void loopback::consume(size_t n) {
+
+		std::lock_guard guard(lock);
+
+		tx_head = std::min(tx.length(), tx_head + n);
+
+		if(tx_head == tx.length()) {
+			tx.clear();
+			tx_head = 0;
+		}
+	}
+}
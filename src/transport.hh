@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+
+#include <sys/types.h>
+#include <termios.h>
+
+namespace jank {
+
+	//
+	// byte stream to a reader; fd() is what msr waits on and becomes
+	// readable whenever read() has something to return
+	//
+
+	class transport {
+
+		public:
+
+			virtual ~transport();
+
+			virtual int fd() const = 0;
+
+			virtual ssize_t read(void *, size_t) = 0;
+			virtual ssize_t write(const void *, size_t) = 0;
+
+			virtual bool configure(long, bool);
+			virtual bool discard() = 0;
+
+			virtual bool serial() const;
+
+			virtual bool reopen();
+
+			static std::unique_ptr<transport> open(const char *);
+	};
+
+	//
+	// any descriptor; a tty gets raw 8N1 line settings at the configured
+	// rate and, in low-latency mode, ASYNC_LOW_LATENCY where the driver
+	// supports it; one opened from a path can be reopened after a hang-up
+	//
+
+	class fd_transport : public transport {
+
+		public:
+
+			int fd() const override;
+
+			ssize_t read(void *, size_t) override;
+			ssize_t write(const void *, size_t) override;
+
+			bool configure(long, bool) override;
+			bool discard() override;
+
+			bool serial() const override;
+
+			bool reopen() override;
+
+			int release();
+
+			static speed_t speed(long);
+			static std::string identify(const char *);
+
+			fd_transport(int, const std::string& = "");
+			~fd_transport() override;
+
+		protected:
+
+			int descriptor;
+
+			std::string path;
+
+			long baud;
+			bool low_latency;
+
+		private:
+
+			int serial_flags;
+	};
+
+	//
+	// raw TCP serial bridge ("tcp:host:port"); line settings belong to the
+	// bridge, so only Nagle is turned off here
+	//
+
+	class tcp_transport : public fd_transport {
+
+		public:
+
+			bool configure(long, bool) override;
+
+			bool reopen() override;
+
+			static int connect(const char *, const char *);
+
+			tcp_transport(int, const std::string&, const std::string&);
+
+		private:
+
+			std::string host;
+			std::string port;
+	};
+
+	//
+	// in-process device: bytes written by msr collect in sent() for the
+	// peer to inspect in place, and the peer's replies go in with feed()
+	//
+
+	class loopback : public transport {
+
+		public:
+
+			int fd() const override;
+
+			ssize_t read(void *, size_t) override;
+			ssize_t write(const void *, size_t) override;
+
+			bool discard() override;
+
+			void feed(std::string_view);
+
+			std::string_view sent() const;
+			void consume(size_t);
+
+			loopback();
+			~loopback() override;
+
+		private:
+
+			int event_fd;
+
+			mutable std::mutex lock;
+
+			std::string rx;
+			size_t rx_head;
+
+			std::string tx;
+			size_t tx_head;
+	};
+}